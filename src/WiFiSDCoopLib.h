@@ -4,15 +4,41 @@
  * Attached routes ar functions in form:
  *     void function HANDLER(const string ROUTE, const int IPD);
  *
+ * Request body (POST, PUT...) is not stored. Handler can pass it to a function as it arrives, with setBodySink(IPD, SINK),
+ * or to a SD file, with receiveFileByIPD(IPD, PATH). Body length is taken from Content-Length header.
+ *
+ * For live data handler can call subscribeEventsByIPD(IPD, CHANNELS) instead answering: link is kept open as a Server-Sent
+ * Events stream and gets what sketch sends with publish(CHANNEL, DATA). Only latest data of each channel is sent, all
+ * pending channels of a link at once. A subscriber that doesn't accept data in time is dropped.
+ *
  * Used defines, used to configure library:
  *   WiFiSDCoopLib_DEV Serial device to use. Default: Serial2 on STM32, Serial on others
  *   WiFiSDCoopLib_BAUDS Bauds of serial device. Default: 115200
- *   WiFiSDCoopLib_COOP_SD_CHUNK When SD cooperative multitasking is enabled, data chunk size in unsigned charS. Default: 64.
- * 
- * It's not formely correct that a library depends on the program, but as this is a resource-limited environment (microcontroller) I prefer to do this
- * instead including all code (lot of program space and even RAM) or creating a bunch of libraries, one for each configuration.
- * This method should never be used on a current computer program.
- * 
+ *   WiFiSDCoopLib_COOP_SD_CHUNK When SD cooperative multitasking is enabled, data chunk size in unsigned charS. Default: 128.
+ *   WiFiSDCoopLib_COOP_SD_MAX_IPDS Max simultaneous links of the module. Default: 8 on STM32, 5 on others
+ *   WiFiSDCoopLib_COOP_SD_BUFFERS File chunk buffers, read from SD while previous one is sent. Default: 1 on AVR, 2 on others
+ *   WiFiSDCoopLib_RX_RING If defined, serial is received using a ring buffer of this size (power of 2) instead reading the device directly.
+ *       You need to feed it from UART RX interrupt or DMA: ESP.getRx().push(c) / ESP.getRx().pushBytes(buffer, length)
+ *   WiFiSDCoopLib_RX_SPAN Max chars read from reception source at once. Default: 32
+ *   WiFiSDCoopLib_UPLOAD_BLOCK SD write size of uploads, should divide SD sector (512). Allocated only while an upload runs. Default: 64 on AVR, 512 on others
+ *   WiFiSDCoopLib_RECV_PULL With passive receive, max chars requested at once. Default: WiFiSDCoopLib_UPLOAD_BLOCK
+ *   WiFiSDCoopLib_BUSY_RETRY When module refuses a send because it's busy (e.g. joining an AP), ms before retrying it. Default: 250
+ *   WiFiSDCoopLib_EVENT_TIMEOUT Max wait for module to accept events to a subscriber, in ms; then it's dropped. Default: 300
+ *   WiFiSDCoopLib_EVENT_DATA_MAX Max published data length of each channel, longer one is truncated. 0 compiles events out. Default: 16 on AVR, 128 on others
+ *
+ * Those defines only configure WiFiSDCoopLib class, the ready-to-use instance type. Library core is WiFiSDCoopLibT template:
+ *
+ *     WiFiSDCoopLibT<DEVICE_TYPE, FILESYSTEM_TYPE, CHUNK_SIZE, MAX_IPDS[, RX_TYPE[, FILE_BUFFERS]]> name(device, filesystem[, bauds]);
+ *
+ * DEVICE_TYPE needs begin(bauds), available(), read() and print(...), as any Arduino serial. RX_TYPE is the reception source,
+ * see WiFiSDCoopLibRx.h; by default data is read from device. FILESYSTEM_TYPE needs open(path)
+ * returning a File-like object, as SD. As types are known at compile time, device calls can be inlined, buffers are sized
+ * at compile time and several instances, each one on its own device, can coexist; even using in-memory stand-ins on a computer.
+ * FILE_BUFFERS is the number of CHUNK_SIZE file buffers: while one is being sent the next ones are read from SD. 1 disables it.
+ * Default is WiFiSDCoopLib_COOP_SD_BUFFERS.
+ *
+ * Device independent code (routes, work queue, wifiLoop() budget) is on WiFiSDCoopLibBase, compiled only once.
+ *
  * @copyright Naguissa
  * @author Naguissa
  * @email naguissa.com@gmail.com
@@ -26,14 +52,27 @@
 	#ifndef __SD_H__
 		#include "SD.h"
 	#endif
+	#include "WiFiSDCoopLibBase.h"
+	#include "WiFiSDCoopLibRx.h"
+
 	#ifndef WiFiSDCoopLib_COOP_SD_CHUNK
 		#define WiFiSDCoopLib_COOP_SD_CHUNK 128
 	#endif
 
-	#ifdef _VARIANT_ARDUINO_STM32_
-		#define WiFiSDCoopLib_COOP_SD_MAX_IPDS 8
-	#else
-		#define WiFiSDCoopLib_COOP_SD_MAX_IPDS 5
+	#ifndef WiFiSDCoopLib_COOP_SD_BUFFERS
+		#ifdef __AVR__
+			#define WiFiSDCoopLib_COOP_SD_BUFFERS 1 // RAM is scarce; read ahead is opt-in
+		#else
+			#define WiFiSDCoopLib_COOP_SD_BUFFERS 2
+		#endif
+	#endif
+
+	#ifndef WiFiSDCoopLib_COOP_SD_MAX_IPDS
+		#ifdef _VARIANT_ARDUINO_STM32_
+			#define WiFiSDCoopLib_COOP_SD_MAX_IPDS 8
+		#else
+			#define WiFiSDCoopLib_COOP_SD_MAX_IPDS 5
+		#endif
 	#endif
 
 
@@ -54,95 +93,233 @@
 		#endif
 	#endif
 
+	#ifndef WiFiSDCoopLib_RX_SPAN
+		#define WiFiSDCoopLib_RX_SPAN 32
+	#endif
 
-	#define WiFiSDCoopLib_TYPE_DATA 0
-	#define WiFiSDCoopLib_TYPE_FILE 1
-	#define WiFiSDCoopLib_TYPE_COMMAND 2
-	#define WiFiSDCoopLib_TYPE_CLOSEIPD 3
+	// STA background join: time to wait for module to get an IP before reporting failure; in ms
+	#ifndef WiFiSDCoopLib_JOIN_TIMEOUT
+		#define WiFiSDCoopLib_JOIN_TIMEOUT 20000
+	#endif
 
-	#define WiFiSDCoopLib_RESPONSE_NO 1
-	#define WiFiSDCoopLib_RESPONSE_GENERIC 2
-	#define WiFiSDCoopLib_RESPONSE_CIPSEND 3
-	#define WiFiSDCoopLib_RESPONSE_DATA 4
-	#define WiFiSDCoopLib_RESPONSE_RESET 5
+	#ifndef WiFiSDCoopLib_UPLOAD_BLOCK
+		#ifdef __AVR__
+			#define WiFiSDCoopLib_UPLOAD_BLOCK 64
+		#else
+			#define WiFiSDCoopLib_UPLOAD_BLOCK 512
+		#endif
+	#endif
 
-	// delay after a CIPCLOSE until new transmission, in ms;. Neded to avoid "Busy" problems 
-	#define WiFiSDCoopLib_TYPE_CLOSEIPD_DELAY 500
+	#ifndef WiFiSDCoopLib_RECV_PULL
+		#define WiFiSDCoopLib_RECV_PULL WiFiSDCoopLib_UPLOAD_BLOCK
+	#endif
+
+	#ifndef WiFiSDCoopLib_BUSY_RETRY
+		#define WiFiSDCoopLib_BUSY_RETRY 250
+	#endif
+
+	#ifndef WiFiSDCoopLib_EVENT_TIMEOUT
+		#define WiFiSDCoopLib_EVENT_TIMEOUT 300
+	#endif
+
+	#ifndef WiFiSDCoopLib_EVENT_DATA_MAX
+		#ifdef __AVR__
+			#define WiFiSDCoopLib_EVENT_DATA_MAX 16
+		#else
+			#define WiFiSDCoopLib_EVENT_DATA_MAX 128
+		#endif
+	#endif
+
+	// Longest module line or request header to be checked; longer ones are truncated
+	#ifndef WiFiSDCoopLib_LINE_MAX
+		#define WiFiSDCoopLib_LINE_MAX 48
+	#endif
+
+
+	// Latest published data of each event channel, fixed to avoid heap fragmentation. Size 0 leaves events out, with no storage
+	template <unsigned int Size>
+	struct WiFiSDCoopLibEventStore {
+		char data[WiFiSDCoopLib_EVENT_CHANNELS][Size + 1];
+		unsigned char isSet = 0; // Channels with data
+
+		const char * get(const unsigned char channel) {
+			return (isSet & (1 << channel)) ? data[channel] : NULL;
+		}
 
+		void set(const unsigned char channel, const char * value) { // If not delivered yet, it's replaced
+			strncpy(data[channel], value, Size);
+			data[channel][Size] = '\0';
+			isSet |= 1 << channel;
+		}
+	};
+
+	template <>
+	struct WiFiSDCoopLibEventStore<0> {
+		const char * get(const unsigned char) {
+			return NULL;
+		}
+
+		void set(const unsigned char, const char *) {}
+	};
+
+
+	// Shorteners for template members definitions
+	#define WiFiSDCoopLibT_TEMPLATE template <class DevT, class FsT, unsigned int ChunkSize, unsigned char MaxIPDs, class RxT, unsigned char Buffers>
+	#define WiFiSDCoopLibT_CLASS WiFiSDCoopLibT<DevT, FsT, ChunkSize, MaxIPDs, RxT, Buffers>
+
+
+	template <class DevT, class FsT, unsigned int ChunkSize, unsigned char MaxIPDs, class RxT = WiFiSDCoopLibStreamRx<DevT>, unsigned char Buffers = WiFiSDCoopLib_COOP_SD_BUFFERS>
+	class WiFiSDCoopLibT : public WiFiSDCoopLibBase {
+		static_assert(512 % WiFiSDCoopLib_UPLOAD_BLOCK == 0, "WiFiSDCoopLib_UPLOAD_BLOCK must divide SD sector size, 512");
+		static_assert(Buffers > 0, "WiFiSDCoopLibT needs at least 1 file buffer");
 
-	class WiFiSDCoopLib {
 		public:
-			WiFiSDCoopLib();
+			WiFiSDCoopLibT(DevT &, FsT &, const unsigned long int = WiFiSDCoopLib_BAUDS);
 
 			void reinit();
-			void setMode(const char);
-			void setSSID(const String);
-			void setSSID(const char []);
-			void setPass(const String);
-			void setPass(const char []);
+			// Reinit without reset, only changing what differs; STA join is done in background. Resets module only if it doesn't answer
+			void fastReinit();
+			char getJoinState();
 			// Used for setting-up Wifi Module to desired speed.
 			// Remember to change Arduino sketch speed when changing to adapt to new one.
 			void setBaudRate(const String);
 
 			String getIPInfo(); // Dangerous, don't use on cooperative mode, only on reinit or setup().
 
-			void attachRoute(const String, void (*)(const String, const unsigned char), const char = 0);
-			void attachRoute(const char[], void (*)(const String, const unsigned char), const char = 0);
-			void clearRoutes();
+			// Link state table, fed by module notifications
+			char getLinkState(const unsigned char);
+			unsigned long int getLinkLastEvent(const unsigned char);
+			unsigned int getLinkPurged(const unsigned char);
 
-			void sendDataByIPD(const unsigned char, const String, const int = 2000);
-			void sendDataByIPD(const unsigned char, const char *, const int = 2000);
-			void sendDataByIPD(const unsigned char, const char, const int = 500);
-			void sendDataByIPD(const unsigned char, const int, const int = 500);
+			void setBodySink(const unsigned char, WiFiSDCoopLibBodySink);
+			bool receiveFileByIPD(const unsigned char, const char *);
+			using WiFiSDCoopLibBase::receiveFileByIPD;
+			bool subscribeEventsByIPD(const unsigned char, const unsigned char = 1);
+			void publish(const unsigned char, const char *);
+			using WiFiSDCoopLibBase::publish;
 
-			void sendFileByIPD(const unsigned char, const String, const int = 2000);
-			void sendFileByIPD(const unsigned char, const char *, const int = 2000);
+			inline unsigned char getMaxIPDs() {
+				return MaxIPDs;
+			}
 
-			// Internal use, but public because may be useful externally
-			void itocp(char *, int);
+			inline bool hasIncomingData() {
+				return _dev_available();
+			}
 
-			void wifiLoop();
+			// Reception source, to feed it if it's not the device itself
+			inline RxT & getRx() {
+				return _rx;
+			}
+
+		protected:
+			static FsT & _fsType(); // Never defined, only to get file type
+			typedef decltype(_fsType().open("")) FileT;
+
+			DevT & _dev;
+			RxT _rx;
+			FsT & _fs;
+			unsigned long int _bauds;
 
-		private: 
-			String buffer;
-			char *ssid = NULL;
-			char *pass = NULL;
-			char mode = '2'; //1= Sta, 2= AP, 3=both. Sta is a device, AP is a router
-			typedef struct {
-				char * route = NULL;
-				void (* fp)(const String, const unsigned char);
-				char mode; // 0 same string, 1 starts with, 2 ends with, 3 found in any position
-				void * next = NULL;
-			} IPDStruct;
-			IPDStruct * IPDs = NULL;
-			void _clearRoutes(IPDStruct *);
-			void * _attachRoute_common();
-			typedef struct {
-				char * str = NULL;
-				char mode; // 0 string, 1 file, 2 command
-				unsigned char ipd;
-				int timeout;
-				void * next = NULL;
-			} WorkItemStruct;
-			WorkItemStruct * WorkQueue = NULL;
 			WorkItemStruct * _actualFileSendRegiter = NULL;
-			File _actualFile;
-			char *_fileBuffer;
-			unsigned char _fileBufferPos = 0;
-			byte _chunkSize = 64;
+			FileT _actualFile;
+			// File buffers ring: _fileBufferCount ready ones from _fileBufferHead, the first one is the one being sent
+			char _fileBuffer[Buffers][ChunkSize + 1];
+			unsigned int _fileBufferLength[Buffers]; // Files may contain NULs, so length is kept
+			unsigned char _fileBufferHead = 0;
+			unsigned char _fileBufferCount = 0;
+			unsigned long int _fileRemaining = 0; // Bytes still to be read from actual file
+			typedef struct {
+				char state = WiFiSDCoopLib_LINK_CLOSED;
+				unsigned long int lastEvent = 0; // millis() of last CONNECT / CLOSED
+				unsigned int connects = 0;
+				unsigned int purged = 0; // Queued items discarded because link was closed
+				char rangeType = WiFiSDCoopLib_RANGE_NONE; // Range header of last request
+				unsigned long int rangeStart = 0;
+				unsigned long int rangeEnd = 0; // Suffix length on WiFiSDCoopLib_RANGE_SUFFIX
+				unsigned long int bodyRemaining = 0; // Request body chars still to come
+				WiFiSDCoopLibBodySink sink = NULL;
+				bool closeAfterBody = false;
+				unsigned int recvPending = 0; // Passive receive: chars held on module
+				unsigned char events = 0; // Subscribed event channels
+				unsigned char eventsPending = 0; // Channels with data not sent yet
+				char heldStep = 0; // Request headers continuing on next payload of this link
+				String heldLine; // Partial header line
+				String heldRoute;
+			} LinkStruct;
+			LinkStruct _links[MaxIPDs];
+			bool _purgePending = false;
+
+			char _joinState = WiFiSDCoopLib_JOIN_NONE;
+			unsigned long int _joinTimer = 0; // Join timeout
+			int _commandDelay = 150; // Wait after each command response, in ms
+
+			void _resetState();
+			void _configureAP();
+			void _startJoin();
+			void _checkModuleEvent(const char *);
+
+			void _wifiLoopSteps();
+
+			// Upload, only one at a time
+			FileT _uploadFile;
+			char * _uploadPath = NULL; // Also marks an active upload
+			unsigned char _uploadIPD = 0;
+			bool _uploadError = false;
+			char * _uploadBlock = NULL; // Only allocated while an upload is active
+			unsigned int _uploadBlockPos = 0;
+
+			void _bodyData(const unsigned char, const char *, const unsigned int, const char);
+			void _uploadData(const char *, unsigned int, const char);
+			void _uploadWrite();
+
+			bool _passiveActive = false; // Passive receive, if module supports it
+			unsigned char _recvIPD = 0; // Link of last data request
+			unsigned char _recvNext = 0; // Round-robin start point
+
+			void _setReceiveMode();
+			void _recvLoop();
 
-			void _init();
+			WiFiSDCoopLibEventStore<WiFiSDCoopLib_EVENT_DATA_MAX> _eventData;
+			unsigned char _eventNext = 0; // Round-robin start point
 
-			char _dev_read();
-			bool _dev_available();
+			void _eventsLoop();
+			void _eventAppend(String &, const unsigned char);
 
-			void _cleanWorkQueue();
-			void _cleanWorkQueueSub(WorkItemStruct * item);
-			void * _getNewWorkQueueItem(const unsigned char, char, const int);
-			void _removeWorkQueueItem(WorkItemStruct *);
+			// Parser state, kept between calls as a request can arrive in several reads
+			char _parseStep = 0;
+			unsigned char _ipd = 0;
+			unsigned int _ipdRemaining = 0; // +IPD payload chars still to come
+			String _route;
+			char _line[WiFiSDCoopLib_LINE_MAX];
+			byte _linePos = 0;
+
+			bool _parseChar(const char);
+			inline void _lineAdd(const char c) {
+				if (_linePos < WiFiSDCoopLib_LINE_MAX - 1) {
+					_line[_linePos] = c;
+					_linePos++;
+				}
+			}
+			void _payloadStart();
+			unsigned int _parseBody(const char *, unsigned int);
+			void _requestStart();
+			void _checkHeader();
+			void _parseRange(const char *);
+			void _requestReceived();
+
+			void _checkLinkEvent(const char *);
+			void _linkClosed(const unsigned char);
+			void _purgeWorkQueue();
+
+			inline bool _dev_available() {
+				return _rx.available() > 0;
+			}
 
 			void _startFileTransaction(WorkItemStruct *);
+			bool _fileToCache(WorkItemStruct *);
+			bool _startHTTPFile(WorkItemStruct *);
 			void _fileLoop();
+			void _fileReadAhead();
 
 			String _send(const String, const int, const bool = false, byte = WiFiSDCoopLib_RESPONSE_GENERIC);
 			String _send(const char*, const int, const bool = false, byte = WiFiSDCoopLib_RESPONSE_GENERIC);
@@ -154,112 +331,1346 @@
 			#define _sendPart(s) _send(s, 0, true, WiFiSDCoopLib_RESPONSE_NO)
 			#define _getResponse(timeout, type) _send_common(timeout, true, type);
 
-			void _sendDataByIPD(const unsigned char, const char*, const int = 2000);
-			void _sendDataByIPD_common(const unsigned char);
+			bool _sendDataByIPD(const unsigned char, const char*, const int = 2000);
+			bool _sendDataByIPD(const unsigned char, const char*, const unsigned int, const int);
+			bool _sendBusy = false; // Last _sendDataByIPD was refused by busy module, so nothing was sent and it can be retried
+			void _busyRetry();
+			bool _sendDataWrite(const unsigned char, const char*, const unsigned int);
+			bool _sendDataStart(const unsigned char, const char*, const unsigned int, const int);
+			void _sendDataEnd();
+			char _sendState = WiFiSDCoopLib_SEND_IDLE;
+			unsigned long int _sendTimer = 0; // SEND OK timeout
+			WorkItemStruct * _sendItem = NULL; // Queue item being sent, removed when done
+			bool _sendChunk = false; // File chunk being sent, released when done
 
-			void _sendCommandByIPD(const unsigned char, const char*, const int = 500);
-			void _sendCommandByIPD(const unsigned char, const String, const int = 500);
-			void _sendCloseIPD(const unsigned char);
+			void _checkESPAvailableData(const int, String * = NULL, const byte response = WiFiSDCoopLib_RESPONSE_NO);
+	};
 
-			unsigned long int _waitAfterIPDTimer = 0;
 
+	// Ready-to-use instance type, configured with defines above
+	#ifdef WiFiSDCoopLib_RX_RING
+		typedef WiFiSDCoopLibT<decltype(WiFiSDCoopLib_DEV), decltype(SD), WiFiSDCoopLib_COOP_SD_CHUNK, WiFiSDCoopLib_COOP_SD_MAX_IPDS, WiFiSDCoopLibRingRx<WiFiSDCoopLib_RX_RING>, WiFiSDCoopLib_COOP_SD_BUFFERS> WiFiSDCoopLibDefaultT;
+	#else
+		typedef WiFiSDCoopLibT<decltype(WiFiSDCoopLib_DEV), decltype(SD), WiFiSDCoopLib_COOP_SD_CHUNK, WiFiSDCoopLib_COOP_SD_MAX_IPDS, WiFiSDCoopLibStreamRx<decltype(WiFiSDCoopLib_DEV)>, WiFiSDCoopLib_COOP_SD_BUFFERS> WiFiSDCoopLibDefaultT;
+	#endif
 
-			void _checkESPAvailableData(const int, String * = NULL, const byte response = WiFiSDCoopLib_RESPONSE_NO);
+	class WiFiSDCoopLib : public WiFiSDCoopLibDefaultT {
+		public:
+			WiFiSDCoopLib() : WiFiSDCoopLibDefaultT(WiFiSDCoopLib_DEV, SD) {}
 	};
 
-	// THESE FUNCTIONS ARE DEFINED HERE TO BE ABLE TO USE DEFINITIONS ON MAIN PROGRAM
-	#ifndef __WiFiSDCoopLib_C__
 
-		void WiFiSDCoopLib::_init() {
-			_chunkSize = WiFiSDCoopLib_COOP_SD_CHUNK;
-			_fileBuffer = (char *) malloc(sizeof(char) * (WiFiSDCoopLib_COOP_SD_CHUNK + 1));
-		}
-
-		char WiFiSDCoopLib::_dev_read() {
-			return WiFiSDCoopLib_DEV.read();
-		}
 
-		bool WiFiSDCoopLib::_dev_available() {
-			return WiFiSDCoopLib_DEV.available();
+	WiFiSDCoopLibT_TEMPLATE
+	WiFiSDCoopLibT_CLASS::WiFiSDCoopLibT(DevT & dev, FsT & fs, const unsigned long int bauds) : _dev(dev), _rx(dev), _fs(fs), _bauds(bauds) {
+		for (unsigned char tmp = 0; tmp < MaxIPDs; tmp++) {
+			_links[tmp].state = WiFiSDCoopLib_LINK_CLOSED;
+			_links[tmp].lastEvent = 0;
+			_links[tmp].connects = 0;
+			_links[tmp].purged = 0;
 		}
+	}
 
 
-		void WiFiSDCoopLib::reinit() {
-			_cleanWorkQueue();
-		  	WiFiSDCoopLib_DEV.begin(WiFiSDCoopLib_BAUDS);
-			_send(F("AT+RST"), 1500, false, WiFiSDCoopLib_RESPONSE_RESET); // RST produces an "OK" that returns from command _send but still has to reset.
-			delay(1000);
-			_send(F("AT"), 100); // To avoid a after-reset bug in new firm
-			delay(1000);
-			_sendPart(F("AT+CWMODE="));
-			_send(String(mode), 300);
-			if (mode != '1') { // Configure AP
-				_sendPart(F("AT+CWSAP=\""));
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::reinit() {
+		_resetState();
+		_dev.begin(_bauds);
+		_send(F("AT+RST"), 1500, false, WiFiSDCoopLib_RESPONSE_RESET); // RST produces an "OK" that returns from command _send but still has to reset.
+		delay(1000);
+		_send(F("AT"), 100); // To avoid a after-reset bug in new firm
+		delay(1000);
+		_sendPart(F("AT+CWMODE="));
+		_send(String(mode), 300);
+		if (mode != '1') { // Configure AP
+			_configureAP();
+		}
+		if (mode != '2') { // Configure STA
+			_joinState = WiFiSDCoopLib_JOIN_FAILED; // Module may still get connected later by itself
+			for(char i = 0; i < 5; i++) {
+				_sendPart(F("AT+CWJAP=\""));
 				_sendPart(ssid);
 				_sendPart(F("\",\""));
 				_sendPart(pass);
-				_send(F("\",1,0"), 1500); // Last param, ench: 0 OPEN; 2 WPA_PSK; 3 WPA2_PSK; 4 WPA_WPA2_PSK 
-			}
-			if (mode != '2') { // Configure STA
-				for(char i = 0; i < 5; i++) {
-					_sendPart(F("AT+CWJAP=\""));
-					_sendPart(ssid);
-					_sendPart(F("\",\""));
-					_sendPart(pass);
-					String res = _send(F("\""), 10000);
-					if(res.indexOf("OK") >= 0) {
-						break;
+				String res = _send(F("\""), 10000);
+				if(res.indexOf("OK") >= 0) {
+					_joinState = WiFiSDCoopLib_JOIN_JOINED;
+					break;
+				}
+			}
+		}
+		_send(F("AT+CIPMUX=1"), 400); // configure for multiple connections
+		_send(F("AT+CIPSERVER=1,80"), 500); // turn on server on port 80
+		if (_passiveReceive) {
+			_setReceiveMode();
+		}
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::fastReinit() {
+		String res;
+		_resetState();
+		_dev.begin(_bauds);
+		_commandDelay = 0; // Responses are checked, no need to wait more
+		res = _send(F("AT"), 200);
+		if (res.indexOf("OK") < 0) {
+			res = _send(F("AT"), 200); // First one may fail because of garbage on module input
+		}
+		if (res.indexOf("OK") < 0) { // Unresponsive, full reset
+			_commandDelay = 150;
+			reinit();
+			return;
+		}
+		res = _send(F("AT+CWMODE?"), 300);
+		if (res.indexOf(String(F("+CWMODE:")) + mode) < 0) {
+			_sendPart(F("AT+CWMODE="));
+			_send(String(mode), 300);
+		}
+		if (mode != '1') {
+			res = _send(F("AT+CWSAP?"), 500);
+			if (res.indexOf(String(F("+CWSAP:\"")) + ssid + F("\",\"") + pass + F("\",1,0")) < 0) {
+				_configureAP();
+			}
+		}
+		res = _send(F("AT+CIPMUX?"), 300);
+		if (res.indexOf("+CIPMUX:1") < 0) {
+			_send(F("AT+CIPMUX=1"), 400);
+		}
+		_send(F("AT+CIPSERVER=1,80"), 500); // If already on module only answers "no change"
+		if (_passiveReceive || _send(F("AT+CIPRECVMODE?"), 300).indexOf("+CIPRECVMODE:1") >= 0) {
+			_setReceiveMode();
+		}
+		// Join last, as module is busy until it ends
+		if (mode != '2') {
+			res = _send(F("AT+CWJAP?"), 500);
+			if (res.indexOf(String(F("+CWJAP:\"")) + ssid + '"') >= 0) {
+				_joinState = WiFiSDCoopLib_JOIN_JOINED;
+			} else {
+				_send(F("AT+CWAUTOCONN=1"), 300); // Module reconnects by itself from stored AP
+				// Stored AP is already right, so it's just connecting (e.g. after module reset): don't interrupt it
+				res = _send(F("AT+CWJAP_DEF?"), 500);
+				if (res.indexOf(String(F("+CWJAP_DEF:\"")) + ssid + '"') >= 0) {
+					_joinState = WiFiSDCoopLib_JOIN_JOINING;
+					_joinTimer = millis() + WiFiSDCoopLib_JOIN_TIMEOUT;
+				} else {
+					_startJoin();
+				}
+			}
+		}
+		_commandDelay = 150;
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	char WiFiSDCoopLibT_CLASS::getJoinState() {
+		return _joinState;
+	}
+
+	// Anything pending is lost on reinit
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_resetState() {
+		_cleanWorkQueue();
+		if (_actualFile) {
+			_actualFile.close();
+		}
+		_actualFileSendRegiter = NULL;
+		_fileRemaining = 0;
+		_fileBufferCount = 0;
+		_sendState = WiFiSDCoopLib_SEND_IDLE;
+		_sendItem = NULL;
+		_sendChunk = false;
+		_purgePending = false;
+		_parseStep = 0;
+		_joinState = WiFiSDCoopLib_JOIN_NONE;
+		_passiveActive = false;
+		if (_uploadPath != NULL) {
+			_uploadData(NULL, 0, WiFiSDCoopLib_BODY_ABORTED);
+		}
+		for (unsigned char tmp = 0; tmp < MaxIPDs; tmp++) {
+			_links[tmp].state = WiFiSDCoopLib_LINK_CLOSED;
+			_links[tmp].bodyRemaining = 0;
+			_links[tmp].sink = NULL;
+			_links[tmp].closeAfterBody = false;
+			_links[tmp].recvPending = 0;
+			_links[tmp].events = 0;
+			_links[tmp].eventsPending = 0;
+			_links[tmp].heldStep = 0;
+			_links[tmp].heldLine = "";
+			_links[tmp].heldRoute = "";
+		}
+	}
+
+	// Old firmwares don't support passive receive; then data is just received as it comes
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_setReceiveMode() {
+		String res = _send(_passiveReceive ? F("AT+CIPRECVMODE=1") : F("AT+CIPRECVMODE=0"), 300);
+		_passiveActive = _passiveReceive && res.indexOf("OK") >= 0;
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_configureAP() {
+		_sendPart(F("AT+CWSAP=\""));
+		_sendPart(ssid);
+		_sendPart(F("\",\""));
+		_sendPart(pass);
+		_send(F("\",1,0"), 1500); // Last param, ench: 0 OPEN; 2 WPA_PSK; 3 WPA2_PSK; 4 WPA_WPA2_PSK
+	}
+
+	// Join is not waited; module answers later and parser checks it. AP is stored on module, so it also reconnects to it by itself
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_startJoin() {
+		_sendPart(F("AT+CWJAP=\""));
+		_sendPart(ssid);
+		_sendPart(F("\",\""));
+		_sendPart(pass);
+		_send(F("\""), 0, false, WiFiSDCoopLib_RESPONSE_NO);
+		_joinState = WiFiSDCoopLib_JOIN_JOINING;
+		_joinTimer = millis() + WiFiSDCoopLib_JOIN_TIMEOUT;
+	}
+
+	// Module status lines about STA connection. Reconnection is left to module auto connect, only state is tracked
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_checkModuleEvent(const char * line) {
+		if (_sendState == WiFiSDCoopLib_SEND_WAIT && (strcmp(line, "SEND OK") == 0 || strcmp(line, "SEND FAIL") == 0)) {
+			_sendState = WiFiSDCoopLib_SEND_DONE;
+			return;
+		}
+		if (_joinState == WiFiSDCoopLib_JOIN_NONE) {
+			return;
+		}
+		if (strcmp(line, "WIFI GOT IP") == 0) {
+			_joinState = WiFiSDCoopLib_JOIN_JOINED;
+		} else if (strcmp(line, "WIFI DISCONNECT") == 0) {
+			_joinState = WiFiSDCoopLib_JOIN_JOINING;
+			_joinTimer = millis() + WiFiSDCoopLib_JOIN_TIMEOUT;
+		} else if (_joinState == WiFiSDCoopLib_JOIN_JOINING && strcmp(line, "FAIL") == 0) { // CWJAP answer
+			_joinState = WiFiSDCoopLib_JOIN_FAILED;
+		}
+	}
+
+
+	WiFiSDCoopLibT_TEMPLATE
+	String WiFiSDCoopLibT_CLASS::getIPInfo() {
+		return _send(F("AT+CIFSR"), 150); // get ip address
+	}
+
+	// Used for setting-up Wifi Module to desired speed.
+	// Remember to change Arduino sketch speed when changing to adapt to new one.
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::setBaudRate(const String br) {
+		_sendPart(F("AT+CIOBAUD="));
+		_send(br, 200);
+	}
+
+
+
+	WiFiSDCoopLibT_TEMPLATE
+	String WiFiSDCoopLibT_CLASS::_send(const String command, const int timeout, const bool removeNL, const byte type) {
+		while (_dev_available()) _checkESPAvailableData(50);
+		_dev.print(command);
+		return _send_common(timeout, removeNL, type);
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	String WiFiSDCoopLibT_CLASS::_send(const char * command, const int timeout, const bool removeNL, const byte type) {
+		while (_dev_available()) _checkESPAvailableData(50);
+		_dev.print(command);
+		return _send_common(timeout, removeNL, type);
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	String WiFiSDCoopLibT_CLASS::_send(const char command, const int timeout, const bool removeNL, const byte type) {
+		while (_dev_available()) _checkESPAvailableData(50);
+		_dev.print(command);
+		return _send_common(timeout, removeNL, type);
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	String WiFiSDCoopLibT_CLASS::_send(const int command, const int timeout, const bool removeNL, const byte type) {
+		while (_dev_available()) _checkESPAvailableData(50);
+		_dev.print(command);
+		return _send_common(timeout, removeNL, type);
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	String WiFiSDCoopLibT_CLASS::_send(const unsigned char command, const int timeout, const bool removeNL, const byte type) {
+		char str[4];
+		itocp(str, command);
+		while (_dev_available()) _checkESPAvailableData(50);
+		_dev.print(str);
+		return _send_common(timeout, removeNL, type);
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	String WiFiSDCoopLibT_CLASS::_send_common(const int timeout, const bool removeNL, const byte type) {
+		String response = "";
+		if (!removeNL) {
+			_dev.print(F("\r\n"));
+		}
+		if (type != WiFiSDCoopLib_RESPONSE_NO && timeout > 0) {
+			_checkESPAvailableData(timeout, &response, type);
+			if (_loopBudget > 0) { // Limited wifiLoop(): not waited here, next queued work just doesn't start before
+				if (_waitAfterIPDTimer < millis() + _commandDelay) {
+					_waitAfterIPDTimer = millis() + _commandDelay;
+				}
+			} else {
+				unsigned long int wait = millis() + _commandDelay;
+				while (wait > millis()) {
+					_runTasks();
+				}
+			}
+		}
+		return response;
+	}
+
+
+
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_checkESPAvailableData(const int timeout, String * response, const byte responseType) {
+		char c;
+		long int time;
+		char  endResponse[10];
+		byte endFlag = 0;
+		byte endLength;
+		byte endPos = 0;
+		bool served = false;
+		char span[WiFiSDCoopLib_RX_SPAN];
+		unsigned int spanLength, spanPos;
+		switch (responseType) {
+			case WiFiSDCoopLib_RESPONSE_GENERIC:
+				strcpy(endResponse, "OK\r\n");
+				endLength = 4;
+				break;
+
+			case WiFiSDCoopLib_RESPONSE_DATA:
+				strcpy(endResponse, "SEND OK\r\n");
+				endLength = 9;
+				break;
+
+			case WiFiSDCoopLib_RESPONSE_CIPSEND:
+				strcpy(endResponse, "> ");
+				endLength = 2;
+				break;
+
+			case WiFiSDCoopLib_RESPONSE_RESET:
+				strcpy(endResponse, "ready\r\n");
+				endLength = 7;
+				break;
+
+			case WiFiSDCoopLib_RESPONSE_NO:
+			default:
+				endLength = 0;
+				break;
+		}
+
+		time = millis() + timeout;
+		while (time > millis()) {
+			while ((spanLength = _rx.readBytes(span, WiFiSDCoopLib_RX_SPAN)) > 0) {
+				for (spanPos = 0; spanPos < spanLength; spanPos++) {
+					if (_parseStep == 12) { // Request body, passed at once
+						spanPos += _parseBody(span + spanPos, spanLength - spanPos) - 1;
+						endPos = 0;
+						endFlag = 0;
+						continue;
+					}
+					c = span[spanPos]; // read the next character.
+					if (response != NULL) {
+						response->concat(c);
+					}
+					if (_parseChar(c)) {
+						served = true;
+					}
+
+					// Logic: If end string is reached endFlag is set. Then, decreases to wait some cycles, that should be without data. If data comes means that end is not valid (probably a string identical to end, but no the end itself.
+					// Once arrives 1, and endPos remains 0 (no more data has come) it's a valid end.
+					if(endLength > 0) {
+						if (endPos == endLength - 1 && c == endResponse[endPos]) {
+							endPos = 0;
+							endFlag = 10;
+						} else if (endPos < endLength - 1) {
+							if (c == endResponse[endPos]) {
+								endPos++;
+							} else {
+								endPos = 0;
+								endFlag = 0;
+							}
+						} else {
+							endPos = 0;
+							endFlag = 0;
+						}
+						// if endPos becomes 0, check again to don't miss a end string start.
+						if (endPos == 0 && c == endResponse[endPos]) {
+							endPos++;
+						}
+					} // End request end checks
+				} // End span
+
+
+			}
+			if (endLength == 0 && _parseStep == 0) { // Input drained and no request half parsed
+				return;
+			}
+			if (responseType == WiFiSDCoopLib_RESPONSE_DATA && Buffers > 1) { // Module is sending, SD is free
+				_fileReadAhead();
+			}
+			_runTasks();
+			if (endFlag > 1) {
+				endFlag--;
+			}
+			if (endLength > 0 && endFlag == 1 && endPos == 0) { // valid END
+				return;
+			}
+			if (served && endLength == 0) { // Not waiting any response, don't wait more
+				return;
+			}
+
+		} // End timeout while
+	}
+
+
+	// Module output parser, char by char. Returns true when a request has been received and routed
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::_parseChar(const char c) {
+		if ((_parseStep >= 7 && _parseStep <= 9) || _parseStep == 11) { // +IPD payload
+			_ipdRemaining--;
+		}
+		switch (_parseStep) {
+			case 0: // Line start
+				if (c != '\r' && c != '\n') {
+					_linePos = 0;
+					_lineAdd(c);
+					_parseStep = c == '+' ? 1 : 10;
+				}
+				break;
+
+			case 1: // "+IPD,"
+			case 2:
+			case 3:
+			case 4:
+				if (c == "+IPD,"[(byte) _parseStep]) {
+					_lineAdd(c);
+					_parseStep++;
+					_ipd = 0;
+				} else if (_parseStep == 1 && c == 'C') { // Maybe "+CIPRECVDATA"
+					_lineAdd(c);
+					_parseStep = 13;
+				} else if (c == '\r' || c == '\n') {
+					_parseStep = 0;
+				} else { // Other line starting with +
+					_lineAdd(c);
+					_parseStep = 10;
+				}
+				break;
+
+			case 5: // Reading IPD channel
+				if (c == ',') {
+					_parseStep++;
+					_ipdRemaining = 0;
+				} else {
+					_ipd = _ipd * 10 + c - 48;
+				}
+				break;
+
+			case 6: // Payload length
+				if (c == ':') {
+					_payloadStart();
+				} else if (c == '\r' || c == '\n') { // Passive receive: only notifies data held on module
+					if (_ipd < MaxIPDs) {
+						_links[_ipd].recvPending = _ipdRemaining;
+					}
+					_parseStep = 0;
+				} else {
+					_ipdRemaining = _ipdRemaining * 10 + c - 48;
+				}
+				break;
+
+			case 7: // GET, post, etc
+				if (c == ' ') {
+					_parseStep++;
+				}
+				break;
+
+			case 8: // Route
+				if (c == ' ') {
+					_parseStep++;
+					_linePos = 0;
+				} else {
+					_route += c;
+				}
+				break;
+
+			case 9: // Headers, until empty line
+				if (c == '\n') {
+					if (_linePos == 0) {
+						_requestReceived();
+						if (_ipdRemaining == 0) {
+							_parseStep = 0;
+						} else {
+							_parseStep = _ipd < MaxIPDs && _links[_ipd].bodyRemaining > 0 ? 12 : 11;
+						}
+						return true;
 					}
+					_line[_linePos] = '\0';
+					_checkHeader();
+					_linePos = 0;
+				} else if (c != '\r') {
+					_lineAdd(c);
 				}
+				break;
+
+			case 10: // Other lines: command responses and notifications
+				if (c == '\r' || c == '\n') {
+					_line[_linePos] = '\0';
+					_checkLinkEvent(_line);
+					_checkModuleEvent(_line);
+					_parseStep = 0;
+				} else {
+					_lineAdd(c);
+				}
+				break;
+
+			case 12: // Request body; usually taken at once before reaching here
+				_parseBody(&c, 1);
+				return false;
+
+			case 13: // "+CIPRECVDATA", answer to passive receive data request
+				if (_linePos < 12 && c == "+CIPRECVDATA"[_linePos]) {
+					_lineAdd(c);
+					if (_linePos == 12) {
+						_parseStep = 14;
+						_ipdRemaining = 0;
+					}
+				} else if (c == '\r' || c == '\n') {
+					_parseStep = 0;
+				} else {
+					_lineAdd(c);
+					_parseStep = 10;
+				}
+				break;
+
+			case 14: // Its length: ",LENGTH:" on old firmwares, ":LENGTH," on new ones
+				if (c >= '0' && c <= '9') {
+					_ipdRemaining = _ipdRemaining * 10 + c - 48;
+					_lineAdd(c);
+				} else if (_linePos > 12) { // Separator after length
+					_ipd = _recvIPD;
+					_payloadStart();
+				}
+				break;
+
+			case 11: // Rest of payload, ignored
+			default:
+				break;
+		}
+		if (((_parseStep >= 7 && _parseStep <= 9) || _parseStep == 11) && _ipdRemaining == 0) { // +IPD payload ended
+			if (_parseStep != 11 && _ipd < MaxIPDs) { // Request headers continue on next payload of this link
+				_links[_ipd].heldStep = _parseStep;
+				_line[_linePos] = '\0';
+				_links[_ipd].heldLine = _parseStep == 9 ? _line : "";
+				_links[_ipd].heldRoute = _route; // Other links' requests may be parsed meanwhile
 			}
-			_send(F("AT+CIPMUX=1"), 400); // configure for multiple connections
-			_send(F("AT+CIPSERVER=1,80"), 500); // turn on server on port 80
+			_parseStep = 0;
 		}
+		return false;
+	}
 
-		String WiFiSDCoopLib::_send(const String command, const int timeout, const bool removeNL, const byte type) {
-			while (_dev_available()) _checkESPAvailableData(50);
-			WiFiSDCoopLib_DEV.print(command);
-			return _send_common(timeout, removeNL, type);
+	// Payload begins: rest of body of a previous request or a new request
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_payloadStart() {
+		if (_ipdRemaining == 0) {
+			_parseStep = 0;
+		} else if (_ipd < MaxIPDs && _links[_ipd].bodyRemaining > 0) {
+			_parseStep = 12;
+		} else if (_ipd < MaxIPDs && _links[_ipd].heldStep != 0) {
+			_parseStep = _links[_ipd].heldStep;
+			_links[_ipd].heldStep = 0;
+			strcpy(_line, _links[_ipd].heldLine.c_str());
+			_linePos = _links[_ipd].heldLine.length();
+			_links[_ipd].heldLine = "";
+			_route = _links[_ipd].heldRoute;
+			_links[_ipd].heldRoute = "";
+		} else {
+			_parseStep = 7;
+			_requestStart();
 		}
+	}
 
-		String WiFiSDCoopLib::_send(const char * command, const int timeout, const bool removeNL, const byte type) {
-			while (_dev_available()) _checkESPAvailableData(50);
-			WiFiSDCoopLib_DEV.print(command);
-			return _send_common(timeout, removeNL, type);
+	// Request body chars, as many as possible at once, directly from received data. Returns used ones
+	WiFiSDCoopLibT_TEMPLATE
+	unsigned int WiFiSDCoopLibT_CLASS::_parseBody(const char * data, unsigned int length) {
+		LinkStruct * link = &_links[_ipd];
+		if (length > _ipdRemaining) {
+			length = _ipdRemaining;
+		}
+		if (length > link->bodyRemaining) {
+			length = link->bodyRemaining;
 		}
+		_ipdRemaining -= length;
+		link->bodyRemaining -= length;
+		_bodyData(_ipd, data, length, link->bodyRemaining == 0 ? WiFiSDCoopLib_BODY_END : WiFiSDCoopLib_BODY_MORE);
+		if (link->bodyRemaining == 0) {
+			if (link->closeAfterBody) {
+				link->closeAfterBody = false;
+				_sendCloseIPD(_ipd);
+			}
+			_parseStep = _ipdRemaining > 0 ? 11 : 0;
+		} else if (_ipdRemaining == 0) {
+			_parseStep = 0;
+		}
+		return length;
+	}
 
-		String WiFiSDCoopLib::_send(const char command, const int timeout, const bool removeNL, const byte type) {
-			while (_dev_available()) _checkESPAvailableData(50);
-			WiFiSDCoopLib_DEV.print(command);
-			return _send_common(timeout, removeNL, type);
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_requestStart() {
+		_route = "";
+		if (_ipd < MaxIPDs) {
+			_links[_ipd].rangeType = WiFiSDCoopLib_RANGE_NONE;
+			_links[_ipd].bodyRemaining = 0;
+			_links[_ipd].sink = NULL;
+			_links[_ipd].events = 0;
+			_links[_ipd].eventsPending = 0;
 		}
+	}
 
-		String WiFiSDCoopLib::_send(const int command, const int timeout, const bool removeNL, const byte type) {
-			while (_dev_available()) _checkESPAvailableData(50);
-			WiFiSDCoopLib_DEV.print(command);
-			return _send_common(timeout, removeNL, type);
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_checkHeader() {
+		if (_ipd >= MaxIPDs) {
+			return;
+		}
+		if (strncasecmp(_line, "Range:", 6) == 0) {
+			_parseRange(_line + 6);
+		} else if (strncasecmp(_line, "Content-Length:", 15) == 0) {
+			_links[_ipd].bodyRemaining = strtoul(_line + 15, NULL, 10);
 		}
+	}
 
-		String WiFiSDCoopLib::_send(const unsigned char command, const int timeout, const bool removeNL, const byte type) {
-			char str[4];
-			itocp(str, command);
-			while (_dev_available()) _checkESPAvailableData(50);
-			WiFiSDCoopLib_DEV.print(str);
-			return _send_common(timeout, removeNL, type);
+	// "bytes=a-b", "bytes=a-" or "bytes=-suffix". Multi-range is marked to be rejected; anything else is ignored, as HTTP says
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_parseRange(const char * value) {
+		unsigned long int start = 0, end = 0;
+		bool hasStart = false, hasEnd = false;
+		while (*value == ' ') {
+			value++;
+		}
+		if (strncasecmp(value, "bytes=", 6) != 0) {
+			return;
+		}
+		value += 6;
+		if (strchr(value, ',') != NULL) {
+			_links[_ipd].rangeType = WiFiSDCoopLib_RANGE_MULTI;
+			return;
+		}
+		while (*value >= '0' && *value <= '9') {
+			start = start * 10 + *value - 48;
+			hasStart = true;
+			value++;
+		}
+		if (*value != '-') {
+			return;
+		}
+		value++;
+		while (*value >= '0' && *value <= '9') {
+			end = end * 10 + *value - 48;
+			hasEnd = true;
+			value++;
+		}
+		while (*value == ' ') {
+			value++;
+		}
+		if (*value != '\0' || (!hasStart && !hasEnd)) {
+			return;
 		}
+		if (hasStart) {
+			_links[_ipd].rangeType = WiFiSDCoopLib_RANGE_SINGLE;
+			_links[_ipd].rangeStart = start;
+			_links[_ipd].rangeEnd = hasEnd ? end : 0xFFFFFFFF;
+		} else {
+			_links[_ipd].rangeType = WiFiSDCoopLib_RANGE_SUFFIX;
+			_links[_ipd].rangeEnd = end;
+		}
+	}
+
+	// Request found, check routes
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_requestReceived() {
+		if (_ipd < MaxIPDs) { // Request implies an open link, even if CONNECT was missed
+			_links[_ipd].state = WiFiSDCoopLib_LINK_OPEN;
+		}
+		IPDStruct * found = _findRoute(_route);
+		if (found != NULL) {
+			found->fp(_route, _ipd + _ipdOffset);
+		} else {
+			sendDataByIPD(_ipd, F("404 - Not found"));
+		}
+		if (_ipd < MaxIPDs && _links[_ipd].bodyRemaining > 0 && (_links[_ipd].sink != NULL || (_uploadPath != NULL && _uploadIPD == _ipd))) {
+			_links[_ipd].closeAfterBody = true; // Body still has to be received
+		} else if (_ipd >= MaxIPDs || _links[_ipd].events == 0) { // Event streams are kept open
+			_sendCloseIPD(_ipd);
+		}
+	}
+
+
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::setBodySink(const unsigned char ipd, WiFiSDCoopLibBodySink sink) {
+		if (ipd >= MaxIPDs) {
+			return;
+		}
+		_links[ipd].sink = sink;
+		if (_links[ipd].bodyRemaining == 0) { // Nothing to receive
+			_bodyData(ipd, NULL, 0, WiFiSDCoopLib_BODY_END);
+		}
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::receiveFileByIPD(const unsigned char ipd, const char * path) {
+		if (ipd >= MaxIPDs || _uploadPath != NULL) {
+			return false;
+		}
+		_uploadBlock = (char *) malloc(sizeof(char) * WiFiSDCoopLib_UPLOAD_BLOCK);
+		if (_uploadBlock == NULL) {
+			return false;
+		}
+		if (_fileCache != NULL) { // Cached copy would be outdated
+			_fileCache->remove(path);
+		}
+		_fs.remove(path); // Replaced, not appended
+		_uploadFile = _fs.open(path, FILE_WRITE);
+		if (!_uploadFile) {
+			free(_uploadBlock);
+			_uploadBlock = NULL;
+			return false;
+		}
+		_uploadPath = (char *) malloc(sizeof(char) * (strlen(path) + 1));
+		strcpy(_uploadPath, path);
+		_uploadIPD = ipd;
+		_uploadError = false;
+		_uploadBlockPos = 0;
+		if (_links[ipd].bodyRemaining == 0) { // Empty file
+			_uploadData(NULL, 0, WiFiSDCoopLib_BODY_END);
+		}
+		return true;
+	}
 
-		String WiFiSDCoopLib::_send_common(const int timeout, const bool removeNL, const byte type) {
-			String response = "";
-			if (!removeNL) {
-				WiFiSDCoopLib_DEV.print(F("\r\n"));
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_bodyData(const unsigned char ipd, const char * data, const unsigned int length, const char state) {
+		if (_uploadPath != NULL && _uploadIPD == ipd) {
+			_uploadData(data, length, state);
+		} else if (_links[ipd].sink != NULL) {
+			_links[ipd].sink(ipd + _ipdOffset, data, length, state);
+		}
+		if (state != WiFiSDCoopLib_BODY_MORE) {
+			_links[ipd].sink = NULL;
+		}
+	}
+
+	// Built-in body sink: SD file, written in whole blocks so writes don't cross SD sectors
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_uploadData(const char * data, unsigned int length, const char state) {
+		unsigned int part;
+		while (length > 0) {
+			part = WiFiSDCoopLib_UPLOAD_BLOCK - _uploadBlockPos;
+			if (part > length) {
+				part = length;
 			}
-			if (type != WiFiSDCoopLib_RESPONSE_NO && timeout > 0) {
-				_checkESPAvailableData(timeout, &response, type); 
-				delay(150);
+			memcpy(_uploadBlock + _uploadBlockPos, data, part);
+			_uploadBlockPos += part;
+			data += part;
+			length -= part;
+			if (_uploadBlockPos == WiFiSDCoopLib_UPLOAD_BLOCK) {
+				_uploadWrite();
 			}
-// Serial.println(response);
-			return response;
 		}
+		if (state == WiFiSDCoopLib_BODY_MORE) {
+			return;
+		}
+		_uploadWrite();
+		_uploadFile.close();
+		if (state == WiFiSDCoopLib_BODY_END) {
+			if (_uploadError) {
+				sendDataByIPD(_uploadIPD, F("HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"));
+			} else {
+				sendDataByIPD(_uploadIPD, F("HTTP/1.1 201 Created\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"));
+			}
+		} else { // Incomplete file is useless
+			_fs.remove(_uploadPath);
+		}
+		if (_fileCache != NULL) { // In case it was read while uploading
+			_fileCache->remove(_uploadPath);
+		}
+		free(_uploadPath);
+		_uploadPath = NULL;
+		free(_uploadBlock);
+		_uploadBlock = NULL;
+	}
 
-	#endif
+	// On error rest of body is still received, but discarded
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_uploadWrite() {
+		if (_uploadBlockPos > 0 && !_uploadError && _uploadFile.write((const uint8_t *) _uploadBlock, _uploadBlockPos) != _uploadBlockPos) {
+			_uploadError = true;
+		}
+		_uploadBlockPos = 0;
+	}
+
+
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::subscribeEventsByIPD(const unsigned char ipd, const unsigned char channels) {
+		if (ipd >= MaxIPDs || channels == 0 || WiFiSDCoopLib_EVENT_DATA_MAX == 0) { // Last one, events compiled out
+			return false;
+		}
+		sendDataByIPD(ipd, F("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n"));
+		_links[ipd].events = channels;
+		_links[ipd].eventsPending = 0;
+		for (unsigned char channel = 0; channel < WiFiSDCoopLib_EVENT_CHANNELS; channel++) { // New subscriber gets actual data
+			if (_eventData.get(channel) != NULL && (channels & (1 << channel))) {
+				_links[ipd].eventsPending |= 1 << channel;
+			}
+		}
+		return true;
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::publish(const unsigned char channel, const char * data) {
+		if (channel >= WiFiSDCoopLib_EVENT_CHANNELS) {
+			return;
+		}
+		// If not delivered yet, it's replaced
+		_eventData.set(channel, data);
+		for (unsigned char tmp = 0; tmp < MaxIPDs; tmp++) {
+			if (_links[tmp].events & (1 << channel)) {
+				_links[tmp].eventsPending |= 1 << channel;
+			}
+		}
+	}
+
+	// One subscriber per call, with all its pending channels in a single send. Waits only for its answer, up to WiFiSDCoopLib_EVENT_TIMEOUT
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_eventsLoop() {
+		unsigned char ipd, channel;
+		unsigned int previous;
+		int commandDelay;
+		unsigned char pending;
+		bool sent;
+		String batch;
+		for (unsigned char tmp = 0; tmp < MaxIPDs; tmp++) {
+			ipd = (_eventNext + tmp) % MaxIPDs;
+			if (_links[ipd].eventsPending != 0 && !_hasWork(ipd)) {
+				_eventNext = (ipd + 1) % MaxIPDs;
+				pending = _links[ipd].eventsPending;
+				for (channel = 0; channel < WiFiSDCoopLib_EVENT_CHANNELS; channel++) {
+					if (_links[ipd].eventsPending & (1 << channel)) {
+						previous = batch.length();
+						_eventAppend(batch, channel);
+						if (previous > 0 && batch.length() > 2048) { // Max send; rest goes on next call
+							batch.remove(previous);
+							break;
+						}
+						_links[ipd].eventsPending &= ~(1 << channel);
+					}
+				}
+				// Pause after commands isn't waited here, so a slow subscriber only costs its timeout; next work waits it instead
+				commandDelay = _commandDelay;
+				_commandDelay = 0;
+				sent = _sendDataByIPD(ipd, batch.c_str(), WiFiSDCoopLib_EVENT_TIMEOUT);
+				_commandDelay = commandDelay;
+				if (_waitAfterIPDTimer < millis() + _commandDelay) {
+					_waitAfterIPDTimer = millis() + _commandDelay;
+				}
+				if (!sent && _sendBusy) { // Module busy, sent again later
+					_links[ipd].eventsPending |= pending;
+					_busyRetry();
+				} else if (!sent) { // Slow or gone, drop it
+					_links[ipd].events = 0;
+					_links[ipd].eventsPending = 0;
+					_sendCloseIPD(ipd);
+				}
+				return;
+			}
+		}
+	}
+
+	// Event of a channel. Each line of data goes on its own data field, as a line break would end it
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_eventAppend(String & batch, const unsigned char channel) {
+		const char * data = _eventData.get(channel);
+		batch += F("event: ");
+		batch += (char) ('0' + channel);
+		batch += F("\ndata: ");
+		for (; *data != '\0'; data++) {
+			if (*data == '\r' || *data == '\n') {
+				if (*data == '\r' && data[1] == '\n') {
+					data++;
+				}
+				batch += F("\ndata: ");
+			} else {
+				batch += *data;
+			}
+		}
+		batch += F("\n\n");
+	}
+
+
+	// Passive receive: requests data of one link, only as much as can be processed when it arrives
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_recvLoop() {
+		unsigned char ipd, held = MaxIPDs;
+		unsigned int length, limit;
+		char str[6];
+		for (ipd = 0; ipd < MaxIPDs; ipd++) { // Unfinished request headers first
+			if (_links[ipd].heldStep != 0 && _links[ipd].recvPending > 0) {
+				held = ipd;
+				break;
+			}
+		}
+		for (unsigned char tmp = 0; tmp < MaxIPDs; tmp++) {
+			ipd = held < MaxIPDs ? held : (_recvNext + tmp) % MaxIPDs;
+			if (_links[ipd].recvPending > 0) {
+				limit = WiFiSDCoopLib_RECV_PULL;
+				if (_uploadPath != NULL && _uploadIPD == ipd && _links[ipd].bodyRemaining > 0) {
+					// Upload block is filled exactly, so it's written to SD when module has ended sending
+					limit = WiFiSDCoopLib_UPLOAD_BLOCK - _uploadBlockPos;
+				}
+				length = _links[ipd].recvPending < limit ? _links[ipd].recvPending : limit;
+				_links[ipd].recvPending -= length; // If module has less it's all, so it's right anyway
+				_recvIPD = ipd;
+				_recvNext = (ipd + 1) % MaxIPDs;
+				_sendPart(F("AT+CIPRECVDATA="));
+				itocp(str, ipd);
+				_sendPart(str);
+				_sendPart(F(","));
+				_send((int) length, 0, false, WiFiSDCoopLib_RESPONSE_NO);
+				_checkESPAvailableData(1000, NULL, WiFiSDCoopLib_RESPONSE_GENERIC);
+				return;
+			}
+		}
+	}
+
+
+	// wifiLoop() work, checking budget between steps
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_wifiLoopSteps() {
+		if(_dev_available()) {
+			_checkESPAvailableData(_loopBudget > 0 ? _loopBudget / 1000 + 1 : 500); // Request fond, check routes
+		}
+
+		if (_purgePending) {
+			_purgeWorkQueue();
+		}
+
+		if (_joinState == WiFiSDCoopLib_JOIN_JOINING && _joinTimer < millis()) { // No IP yet; module keeps trying by itself
+			_joinState = WiFiSDCoopLib_JOIN_FAILED;
+		}
+
+		if (_sendState == WiFiSDCoopLib_SEND_WAIT && _sendTimer < millis()) { // No answer, given up
+			_sendState = WiFiSDCoopLib_SEND_DONE;
+		}
+		if (_sendState == WiFiSDCoopLib_SEND_WAIT) { // Module is sending: nothing else can be sent, but next chunk can be read
+			if (Buffers > 1 && !_overBudget()) {
+				_fileReadAhead();
+			}
+			return;
+		}
+		if (_sendState == WiFiSDCoopLib_SEND_DONE) {
+			_sendDataEnd();
+		}
+
+		if (_passiveActive && !_overBudget()) {
+			_recvLoop();
+		}
+
+		if (_waitAfterIPDTimer < millis()) {
+			// Work queue processing
+			// Check if any send command is in list:
+			bool freeIPDs[MaxIPDs];
+			for (unsigned char tmp = 0; tmp < MaxIPDs; tmp++) {
+				freeIPDs[tmp] = true;
+			}
+			WorkItemStruct * queueItem = WorkQueue;
+			WorkItemStruct * nextItem;
+			unsigned char itemIPD;
+			// Checked on each item, as with a budget pause after each command only moves the timer
+			while (queueItem != NULL && !_overBudget() && _waitAfterIPDTimer < millis() && _sendState == WiFiSDCoopLib_SEND_IDLE) {
+				// Item may be removed while processed, so keep what we need from it
+				nextItem = (WorkItemStruct *) queueItem->next;
+				itemIPD = queueItem->ipd;
+				if (!queueItem->purge && itemIPD < MaxIPDs && freeIPDs[itemIPD]) {
+					switch (queueItem->mode) {
+						case 3: // close IPD
+							_sendPart("AT+CIPCLOSE=");
+							char cc[3];
+							itocp(cc, (int) queueItem->ipd);
+							_send(cc, queueItem->timeout);
+							_removeWorkQueueItem(queueItem);
+							_waitAfterIPDTimer = millis() + WiFiSDCoopLib_TYPE_CLOSEIPD_DELAY;
+							// Prevent any sending on this timeout
+							for (unsigned char tmp = 0; tmp < MaxIPDs; tmp++) {
+								freeIPDs[tmp] = false;
+							}
+							break;
+
+						case 2: // command
+							_send(queueItem->str, queueItem->timeout);
+							_removeWorkQueueItem(queueItem);
+							break;
+
+						case 1: // File
+						case 4: // File with HTTP headers
+							if (ChunkSize == 0) { // File support compiled out
+								_removeWorkQueueItem(queueItem);
+							} else if (_actualFileSendRegiter == NULL) { // No active file transaction now
+								_startFileTransaction(queueItem);
+							}
+							break;
+
+						case 0 : // String
+						default:
+							if (_sendDataStart(queueItem->ipd, queueItem->str, strlen(queueItem->str), queueItem->timeout)) { // Removed when module answers
+								_sendItem = queueItem;
+							} else { // Refused by busy module: kept, retried later
+								_busyRetry();
+							}
+							break;
+					}
+					freeIPDs[itemIPD] = false;
+				}
+				queueItem = nextItem;
+			}
+		}
+		// File sending processing:
+		if (_actualFileSendRegiter != NULL && !_overBudget() && _sendState == WiFiSDCoopLib_SEND_IDLE) {
+			_fileLoop();
+		}
+
+		if (_waitAfterIPDTimer < millis() && !_overBudget() && _sendState == WiFiSDCoopLib_SEND_IDLE) {
+			_eventsLoop();
+		}
+	}
+
+
+	// Link notifications: "n,CONNECT", "n,CLOSED" and "n,CONNECT FAIL"
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_checkLinkEvent(const char * line) {
+		unsigned char ipd = 0;
+		byte pos = 0;
+		while (line[pos] >= '0' && line[pos] <= '9') {
+			ipd = ipd * 10 + line[pos] - 48;
+			pos++;
+		}
+		if (pos == 0 || line[pos] != ',' || ipd >= MaxIPDs) {
+			return;
+		}
+		pos++;
+		if (strcmp(line + pos, "CONNECT") == 0) {
+			_links[ipd].state = WiFiSDCoopLib_LINK_OPEN;
+			_links[ipd].connects++;
+		} else if (strcmp(line + pos, "CLOSED") == 0 || strcmp(line + pos, "CONNECT FAIL") == 0) {
+			_linkClosed(ipd);
+		} else {
+			return;
+		}
+		_links[ipd].lastEvent = millis();
+	}
+
+	// Client is gone: mark all its pending work to be purged and stop its file transaction.
+	// Items are only marked here because this can be called while work queue is being processed.
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_linkClosed(const unsigned char ipd) {
+		_links[ipd].state = WiFiSDCoopLib_LINK_CLOSED;
+		_links[ipd].recvPending = 0;
+		_links[ipd].events = 0;
+		_links[ipd].eventsPending = 0;
+		_links[ipd].heldStep = 0;
+		_links[ipd].heldLine = "";
+		_links[ipd].heldRoute = "";
+		if (_links[ipd].bodyRemaining > 0) { // Before marking, so anything queued by sink is also purged
+			_links[ipd].bodyRemaining = 0;
+			_links[ipd].closeAfterBody = false;
+			_bodyData(ipd, NULL, 0, WiFiSDCoopLib_BODY_ABORTED);
+		}
+		WorkItemStruct * queueItem = WorkQueue;
+		while (queueItem != NULL) {
+			if (queueItem->ipd == ipd && !queueItem->purge) {
+				queueItem->purge = true;
+				_links[ipd].purged++;
+				_purgePending = true;
+			}
+			queueItem = (WorkItemStruct *) queueItem->next;
+		}
+		if (_actualFileSendRegiter != NULL && _actualFileSendRegiter->ipd == ipd && _actualFile) {
+			_actualFile.close();
+			_fileRemaining = 0;
+			_fileBufferCount = 0;
+		}
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_purgeWorkQueue() {
+		WorkItemStruct * queueItem = WorkQueue;
+		WorkItemStruct * nextItem;
+		_purgePending = false;
+		while (queueItem != NULL) {
+			nextItem = (WorkItemStruct *) queueItem->next;
+			if (queueItem->purge) {
+				if (queueItem == _sendItem) {
+					_sendItem = NULL;
+				}
+				if (queueItem == _actualFileSendRegiter) {
+					if (_actualFile) {
+						_actualFile.close();
+					}
+					_actualFileSendRegiter = NULL;
+					_fileRemaining = 0;
+					_fileBufferCount = 0;
+				}
+				_removeWorkQueueItem(queueItem);
+			}
+			queueItem = nextItem;
+		}
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	char WiFiSDCoopLibT_CLASS::getLinkState(const unsigned char ipd) {
+		return ipd < MaxIPDs ? _links[ipd].state : WiFiSDCoopLib_LINK_CLOSED;
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	unsigned long int WiFiSDCoopLibT_CLASS::getLinkLastEvent(const unsigned char ipd) {
+		return ipd < MaxIPDs ? _links[ipd].lastEvent : 0;
+	}
+
+	WiFiSDCoopLibT_TEMPLATE
+	unsigned int WiFiSDCoopLibT_CLASS::getLinkPurged(const unsigned char ipd) {
+		return ipd < MaxIPDs ? _links[ipd].purged : 0;
+	}
+
+
+
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_startFileTransaction(WorkItemStruct * item) {
+		unsigned int cachedLength;
+		const char * cached = _fileCache != NULL && item->mode == WiFiSDCoopLib_TYPE_FILE ? _fileCache->get(item->str, &cachedLength) : NULL;
+		if (cached != NULL) {
+			_sendDataByIPD(item->ipd, cached, cachedLength, item->timeout);
+			_removeWorkQueueItem(item);
+			return;
+		}
+		_fileRemaining = 0; // Nothing is read ahead until file is positioned
+		_fileBufferCount = 0;
+		_actualFile = _fs.open(item->str);
+		if (_actualFile) {
+			// Registered before sending anything, so a CLOSED parsed meanwhile closes the file
+			_actualFileSendRegiter = item;
+			if (item->mode == WiFiSDCoopLib_TYPE_HTTPFILE) {
+				if (!_startHTTPFile(item)) {
+					if (_actualFile) {
+						_actualFile.close();
+					}
+					_actualFileSendRegiter = NULL;
+					if (_sendBusy) { // Header refused: kept and started again later
+						_busyRetry();
+					} else {
+						_removeWorkQueueItem(item);
+					}
+					return;
+				}
+			} else {
+				if (_fileCache != NULL && _fileToCache(item)) {
+					return;
+				}
+				_fileRemaining = _actualFile.size();
+			}
+		} else {
+			if (item->mode == WiFiSDCoopLib_TYPE_HTTPFILE) {
+				_sendDataByIPD(item->ipd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+			} else {
+				_sendDataByIPD(item->ipd, "ERROR - File not found: ");
+				_sendDataByIPD(item->ipd, item->str);
+			}
+			_removeWorkQueueItem(item);
+		}
+	}
+
+	// Sends HTTP headers honouring Range of request and positions file. False if there's no content to send
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::_startHTTPFile(WorkItemStruct * item) {
+		unsigned long int size = _actualFile.size();
+		unsigned long int start = 0, end = size - 1;
+		char rangeType = item->ipd < MaxIPDs ? _links[item->ipd].rangeType : WiFiSDCoopLib_RANGE_NONE;
+		String header;
+		if (rangeType == WiFiSDCoopLib_RANGE_SUFFIX) {
+			start = _links[item->ipd].rangeEnd < size ? size - _links[item->ipd].rangeEnd : 0;
+			if (_links[item->ipd].rangeEnd == 0 || size == 0) {
+				rangeType = WiFiSDCoopLib_RANGE_MULTI;
+			}
+		} else if (rangeType == WiFiSDCoopLib_RANGE_SINGLE) {
+			start = _links[item->ipd].rangeStart;
+			if (_links[item->ipd].rangeEnd < end) {
+				end = _links[item->ipd].rangeEnd;
+			}
+			if (start > _links[item->ipd].rangeEnd) { // Invalid (last < first), ignored
+				rangeType = WiFiSDCoopLib_RANGE_NONE;
+				start = 0;
+				end = size - 1;
+			} else if (start >= size) {
+				rangeType = WiFiSDCoopLib_RANGE_MULTI;
+			}
+		}
+		if (rangeType == WiFiSDCoopLib_RANGE_MULTI) { // Multi-range or not satisfiable, rejected
+			header = F("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */");
+			header += String(size);
+			header += F("\r\nContent-Length: 0");
+			start = 0;
+			end = 0;
+			size = 0;
+		} else if (rangeType == WiFiSDCoopLib_RANGE_NONE) {
+			header = F("HTTP/1.1 200 OK\r\nContent-Length: ");
+			header += String(size);
+		} else {
+			header = F("HTTP/1.1 206 Partial Content\r\nContent-Range: bytes ");
+			header += String(start);
+			header += '-';
+			header += String(end);
+			header += '/';
+			header += String(size);
+			header += F("\r\nContent-Length: ");
+			header += String(end - start + 1);
+		}
+		header += F("\r\nAccept-Ranges: bytes\r\nConnection: close\r\n\r\n");
+		if ((!_sendDataByIPD(item->ipd, header.c_str(), item->timeout) && _sendBusy) || size == 0 || !_actualFile.seek(start)) {
+			return false;
+		}
+		_fileRemaining = end - start + 1;
+		return true;
+	}
+
+	// Reads just opened file into file cache and sends it from there. False if it doesn't fit
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::_fileToCache(WorkItemStruct * item) {
+		char * data = _fileCache->add(item->str, _actualFile.size());
+		if (data == NULL) {
+			return false;
+		}
+		int len = _actualFile.read(data, _actualFile.size());
+		data[len > 0 ? len : 0] = '\0';
+		_actualFile.close();
+		_actualFileSendRegiter = NULL;
+		_sendDataByIPD(item->ipd, data, len > 0 ? len : 0, item->timeout);
+		_removeWorkQueueItem(item);
+		return true;
+	}
+
+	// Each call sends a chunk, if any is ready, or reads one. Next ones are read ahead while waiting for module to send it
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_fileLoop() {
+		if (_actualFile) { // Active file
+			if (_fileBufferCount == 0) {
+				_fileReadAhead();
+			} else if (_waitAfterIPDTimer < millis()) {
+				if (_sendDataStart(_actualFileSendRegiter->ipd, _fileBuffer[_fileBufferHead], _fileBufferLength[_fileBufferHead], _actualFileSendRegiter->timeout)) {
+					_sendChunk = true; // Released when module answers
+					return;
+				}
+				_busyRetry(); // Refused, same chunk again
+			}
+			if (_fileBufferCount == 0 && _fileRemaining == 0) { // close the file and clean register
+				_actualFile.close();
+				_removeWorkQueueItem(_actualFileSendRegiter);
+				_actualFileSendRegiter = NULL;
+			}
+		}
+	}
+
+	// Reads next chunk of actual file into a free buffer, if any. Buffer being sent is never touched
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_fileReadAhead() {
+		if (_actualFileSendRegiter == NULL || !_actualFile || _fileRemaining == 0 || _fileBufferCount >= Buffers) {
+			return;
+		}
+		unsigned char index = (_fileBufferHead + _fileBufferCount) % Buffers;
+		int len = _actualFile.read(_fileBuffer[index], _fileRemaining < ChunkSize ? _fileRemaining : ChunkSize);
+		if (len <= 0) { // EoF or read error
+			_fileRemaining = 0;
+			return;
+		}
+		_fileBuffer[index][len] = '\0';
+		_fileBufferLength[index] = len;
+		_fileRemaining -= len;
+		_fileBufferCount++;
+	}
+
+
+
+	// Real data sending to ESP. False if module hasn't confirmed it
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::_sendDataByIPD(const unsigned char ipd, const char * data, const int timeout) {
+		return _sendDataByIPD(ipd, data, strlen(data), timeout);
+	}
+
+	// Module refused last send, so no send is tried for a while
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_busyRetry() {
+		if (_waitAfterIPDTimer < millis() + WiFiSDCoopLib_BUSY_RETRY) {
+			_waitAfterIPDTimer = millis() + WiFiSDCoopLib_BUSY_RETRY;
+		}
+	}
+
+	// Binary safe, for file data
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::_sendDataByIPD(const unsigned char ipd, const char * data, const unsigned int length, const int timeout) {
+		if (!_sendDataWrite(ipd, data, length)) {
+			return false;
+		}
+		return _send_common(timeout, true, WiFiSDCoopLib_RESPONSE_DATA).indexOf("SEND OK") >= 0;
+	}
+
+	// Send without waiting for SEND OK; parser notices it and _sendDataEnd() finishes it. False if it couldn't start
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::_sendDataStart(const unsigned char ipd, const char * data, const unsigned int length, const int timeout) {
+		int commandDelay = _commandDelay;
+		_commandDelay = 0; // Pause is done when it ends, without waiting
+		bool written = _sendDataWrite(ipd, data, length);
+		_commandDelay = commandDelay;
+		if (written) {
+			_sendState = WiFiSDCoopLib_SEND_WAIT;
+			_sendTimer = millis() + timeout;
+		}
+		return written;
+	}
+
+	// Releases what was being sent and keeps pause after command, without waiting it
+	WiFiSDCoopLibT_TEMPLATE
+	void WiFiSDCoopLibT_CLASS::_sendDataEnd() {
+		_sendState = WiFiSDCoopLib_SEND_IDLE;
+		if (_sendItem != NULL) {
+			_removeWorkQueueItem(_sendItem);
+			_sendItem = NULL;
+		}
+		if (_sendChunk) {
+			_sendChunk = false;
+			if (_fileBufferCount > 0) { // Not dropped meanwhile
+				_fileBufferHead = (_fileBufferHead + 1) % Buffers;
+				_fileBufferCount--;
+			}
+		}
+		if (_waitAfterIPDTimer < millis() + _commandDelay) {
+			_waitAfterIPDTimer = millis() + _commandDelay;
+		}
+	}
+
+	// CIPSEND and data. False, with _sendBusy set, if module refused it because it's busy
+	WiFiSDCoopLibT_TEMPLATE
+	bool WiFiSDCoopLibT_CLASS::_sendDataWrite(const unsigned char ipd, const char * data, const unsigned int length) {
+		char ipdStr[3];
+		itocp(ipdStr, ipd);
+		_sendPart(F("AT+CIPSEND="));
+		_sendPart(ipdStr);
+		_sendPart(F(","));
+		String res = _send((int) length, 30, false, WiFiSDCoopLib_RESPONSE_CIPSEND);
+		_sendBusy = res.indexOf('>') < 0 && res.indexOf("busy") >= 0;
+		if (_sendBusy) {
+			return false;
+		}
+		while (_dev_available()) _checkESPAvailableData(50);
+		_dev.write((const uint8_t *) data, length);
+		return true;
+	}
 #endif
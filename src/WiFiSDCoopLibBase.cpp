@@ -0,0 +1,451 @@
+/**
+ * Library to use ESP8266 WiFi with SD card reader using collaborative multitasking.
+ *
+ * Common part of WiFiSDCoopLib: settings, routes and work queue. See WiFiSDCoopLibBase.h
+ *
+ * @copyright Naguissa
+ * @author Naguissa
+ * @email naguissa.com@gmail.com
+ * @version 1.0.0
+ * @created 2015-06-13
+ */
+#include <Arduino.h>
+#include "WiFiSDCoopLibBase.h"
+
+
+
+WiFiSDCoopLibBase::WiFiSDCoopLibBase() {
+	setSSID("default");
+	setPass("");
+}
+
+void WiFiSDCoopLibBase::setMode(const char m) {
+	mode = m;
+}
+
+void WiFiSDCoopLibBase::setSSID(const String s) {
+	if(ssid != NULL) {
+		free(ssid);
+	}
+	ssid = (char *) malloc((s.length() + 1) * sizeof(char));
+	s.toCharArray(ssid, s.length());
+//	ssid[s.length()] = '\0';
+}
+
+void WiFiSDCoopLibBase::setSSID(const char s[]) {
+	if(ssid != NULL) {
+		free(ssid);
+	}
+	ssid = (char *) malloc((strlen(s) + 1) * sizeof(char));
+	strcpy(ssid, s);
+//	ssid[strlen(s)] = '\0';
+}
+
+void WiFiSDCoopLibBase::setPass(const String s) {
+	if(pass != NULL) {
+		free(pass);
+	}
+	pass = (char *) malloc((s.length() + 1) * sizeof(char));
+	s.toCharArray(pass, s.length());
+//	pass[s.length()] = '\0';
+}
+
+void WiFiSDCoopLibBase::setPass(const char s[]) {
+	if(pass != NULL) {
+		free(pass);
+	}
+	pass = (char *) malloc((strlen(s) + 1) * sizeof(char));
+	strcpy(pass, s);
+//	pass[strlen(s)] = '\0';
+}
+
+void WiFiSDCoopLibBase::setPassiveReceive(const bool passive) {
+	_passiveReceive = passive;
+}
+
+
+void WiFiSDCoopLibBase::itocp(char *str, int n) {
+	unsigned int i = 10;
+	byte pos = 1;
+	char ctmp;
+	if (n >= 0) {
+		str[0] = (n % 10)  + '0';
+		str[1] = '\0';
+		while (i < n) {
+			str[pos] =(((int) (n / i)) % 10)  + '0';
+			i *= 10;
+			pos++;
+		}
+	} else {
+		str[0] = ((-n) % 10)  + '0';
+		str[1] = '\0';
+		while (i < -n) {
+			str[pos] =(((int) ((-n) * 10 / i)) % 10)  + '0';
+			pos++;
+			i *= 10;
+		}
+		str[pos] = '-';
+		pos++;
+	}
+	str[pos] = '\0';
+	// Do floor to position/2 - 1
+	// and reverse the string
+	i = (pos - (pos % 2)) / 2;
+	while (i > 0) {
+		i--;
+		ctmp = str[i];
+		str[i] = str[pos - 1 - i ];
+		str[pos - 1 - i] = ctmp;
+	}
+}
+
+void WiFiSDCoopLibBase::_clearRoutes(IPDStruct * act) {
+	if (act->next != NULL) {
+		_clearRoutes((IPDStruct *) act->next);
+	}
+	if (act->route != NULL) {
+		free(act->route);
+	}
+	free(act);
+}
+
+void WiFiSDCoopLibBase::clearRoutes() {
+	if (*_routeTable != NULL) {
+		_clearRoutes((IPDStruct *) (*_routeTable)->next);
+		*_routeTable = NULL;
+	}
+}
+
+
+void WiFiSDCoopLibBase::attachRoute(const String route, void (*fp)(const String, const unsigned char), const char mode) {
+	IPDStruct * last = (IPDStruct *) _attachRoute_common();
+	last->route = (char *) malloc(sizeof(char) * (route.length() + 1));
+	route.toCharArray(last->route, route.length());
+	last->route[route.length()] = '\0';
+	last->fp = fp;
+	last->mode = mode;
+}
+
+void WiFiSDCoopLibBase::attachRoute(const char route[], void (*fp)(const String, const unsigned char), const char mode) {
+	IPDStruct * last = (IPDStruct *) _attachRoute_common();
+	last->route = (char *) malloc(sizeof(char) * (strlen(route) + 1));
+	strcpy(last->route, route);
+	last->route[strlen(route)] = '\0';
+	last->fp = fp;
+	last->mode = mode;
+}
+
+void * WiFiSDCoopLibBase::_attachRoute_common() {
+	IPDStruct * last;
+	if (*_routeTable != NULL) {
+		last = *_routeTable;
+		while (last->next != NULL) {
+			last = (IPDStruct *) last->next;
+		}
+		last->next = (IPDStruct *) malloc(sizeof(IPDStruct));
+		last = (IPDStruct *) last->next;
+	} else {
+		*_routeTable = (IPDStruct *) malloc(sizeof(IPDStruct));
+		last = *_routeTable;
+	}
+	last->next = NULL;
+	return last;
+}
+
+void WiFiSDCoopLibBase::shareRoutes(WiFiSDCoopLibBase & owner) {
+	_routeTable = owner._routeTable;
+}
+
+// Library work is done in steps; once budget is used it returns when actual step ends (as sending a chunk can't be cut).
+// Sketch tasks run before, between steps and while waiting for module; then idle ones use remaining time.
+void WiFiSDCoopLibBase::wifiLoop(const unsigned long int budget) {
+	bool ran;
+	_loopStart = micros();
+	_loopBudget = budget;
+	_runTasks();
+	_wifiLoopSteps();
+	_loopBudget = 0; // Waits outside wifiLoop() aren't limited
+	if (budget > 0 && _tasks != NULL) {
+		do {
+			ran = _tasks->runDue();
+			ran = _tasks->runIdle() || ran;
+		} while (ran && micros() - _loopStart < budget);
+	}
+}
+
+
+void WiFiSDCoopLibBase::setFileCache(WiFiSDCoopLibFileCache * cache) {
+	_fileCache = cache;
+}
+
+void WiFiSDCoopLibBase::setTasks(WiFiSDCoopLibTasks * tasks) {
+	_tasks = tasks;
+}
+
+
+WiFiSDCoopLibBase::IPDStruct * WiFiSDCoopLibBase::_findRoute(const String route) {
+	IPDStruct * last = *_routeTable;
+	bool found = false;
+	while (last != NULL) {
+		if (last->mode == 4) {// 4 Default route
+			found = true;
+		} else if (strlen(last->route) <= route.length()) {
+			switch (last->mode) {
+				case 3:// 3 found in any position
+					found = route.indexOf(last->route) >= 0;
+					break;
+
+				case 2:// 2 ends with
+					found = route.endsWith(last->route);
+					break;
+
+				case 1:// 1 starts with
+					found = route.startsWith(last->route);
+					break;
+
+				case 0:// 0 same string
+				default:
+					found = route.equals(last->route);
+					break;
+			}
+		}
+		if (found) {
+			return last;
+		}
+		last = (IPDStruct *) last->next;
+	}
+	return NULL;
+}
+
+
+void WiFiSDCoopLibBase::_removeWorkQueueItem(WorkItemStruct * item) {
+	if (WorkQueue == item) { // Actual register is the 1st register of the queue
+		WorkQueue = (WorkItemStruct *) item->next;
+		if (item->str != NULL) {
+			free(item->str);
+		}
+		free(item);
+		return;
+	} else {
+		WorkItemStruct * queueItem = WorkQueue;
+		WorkItemStruct * lastQueueItem = NULL;
+		while (queueItem != NULL) {
+			if (queueItem == item) {
+				lastQueueItem->next = queueItem->next;
+				if (queueItem->str != NULL) {
+					free(queueItem->str);
+				}
+				free(queueItem);
+				return;
+			}
+			lastQueueItem = queueItem;
+			queueItem = (WorkItemStruct *) queueItem->next;
+		}
+	}
+}
+
+// Pending work for that IPD
+bool WiFiSDCoopLibBase::_hasWork(const unsigned char ipd) {
+	WorkItemStruct * queueItem = WorkQueue;
+	while (queueItem != NULL) {
+		if (queueItem->ipd == ipd && !queueItem->purge) {
+			return true;
+		}
+		queueItem = (WorkItemStruct *) queueItem->next;
+	}
+	return false;
+}
+
+void WiFiSDCoopLibBase::_cleanWorkQueueSub(WorkItemStruct * item) {
+	if (item->next != NULL) {
+		_cleanWorkQueueSub((WorkItemStruct *) item->next);
+	}
+	if (item->str != NULL) {
+		free(item->str);
+	}
+	free(item);
+}
+
+void WiFiSDCoopLibBase::_cleanWorkQueue() {
+	if (WorkQueue != NULL) {
+		_cleanWorkQueueSub(WorkQueue);
+		WorkQueue = NULL;
+	}
+}
+
+
+
+void * WiFiSDCoopLibBase::_getNewWorkQueueItem(const unsigned char ipd, char mode, const int timeout) {
+		WorkItemStruct * queueItem;
+	if (WorkQueue == NULL) { // Empty queue
+		WorkQueue = (WorkItemStruct *) malloc(sizeof(WorkItemStruct));
+		queueItem = WorkQueue;
+	} else {
+		queueItem = WorkQueue;
+		while (queueItem->next != NULL) {
+			queueItem = (WorkItemStruct *) queueItem->next;
+		}
+		queueItem->next = (WorkItemStruct *) malloc(sizeof(WorkItemStruct));
+		queueItem = (WorkItemStruct *) queueItem->next;
+	}
+	queueItem->mode = mode;
+	queueItem->ipd = ipd;
+	queueItem->timeout = timeout;
+	queueItem->purge = false;
+	queueItem->next = NULL;
+	queueItem->str = NULL;
+	return (void *) queueItem;
+}
+
+
+
+// Data sending functions, here works as "attach work unit to queue".
+void WiFiSDCoopLibBase::sendDataByIPD(const unsigned char ipd, const String data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_DATA, timeout);
+	item->str = (char *) malloc(sizeof(char) * (data.length() + 1));
+	data.toCharArray(item->str, data.length() + 1);
+}
+
+void WiFiSDCoopLibBase::sendDataByIPD(const unsigned char ipd, const char * data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_DATA, timeout);
+	item->str = (char *) malloc(sizeof(char) * (strlen(data) + 1));
+	strcpy(item->str, data);
+}
+
+void WiFiSDCoopLibBase::sendDataByIPD(const unsigned char ipd, const char data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_DATA, timeout);
+	item->str = (char *) malloc(sizeof(char) * 2);
+	item->str[0] = data;
+	item->str[1] = '\0';
+}
+
+void WiFiSDCoopLibBase::sendDataByIPD(const unsigned char ipd, const int data, const int timeout) {
+	char str[6];
+	itocp(str, data);
+	sendDataByIPD(ipd, str, timeout);
+}
+
+void WiFiSDCoopLibBase::_sendCloseIPD(const unsigned char ipd) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_CLOSEIPD, 100);
+}
+
+void WiFiSDCoopLibBase::_sendCommandByIPD(const unsigned char ipd, const char * data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_COMMAND, timeout);
+	item->str = (char *) malloc(sizeof(char) * (strlen(data) + 1));
+	strcpy(item->str, data);
+}
+
+void WiFiSDCoopLibBase::_sendCommandByIPD(const unsigned char ipd, const String data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_COMMAND, timeout);
+	item->str = (char *) malloc(sizeof(char) * (data.length() + 1));
+	data.toCharArray(item->str, data.length());
+}
+
+
+
+// File sending functions, here works as "attach work unit to queue".
+void WiFiSDCoopLibBase::sendFileByIPD(unsigned char ipd, const String data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_FILE, timeout);
+	item->str = (char *) malloc(sizeof(char) * (data.length() + 1));
+	data.toCharArray(item->str, data.length());
+}
+
+void WiFiSDCoopLibBase::sendFileByIPD(unsigned char ipd, const char * data, const int timeout) {
+	WorkItemStruct * item =(WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_FILE, timeout);
+	item->str = (char *) malloc(sizeof(char) * (strlen(data) + 1));
+	strcpy(item->str, data);
+}
+
+void WiFiSDCoopLibBase::sendHTTPFileByIPD(unsigned char ipd, const String data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_HTTPFILE, timeout);
+	item->str = (char *) malloc(sizeof(char) * (data.length() + 1));
+	data.toCharArray(item->str, data.length() + 1);
+}
+
+void WiFiSDCoopLibBase::sendHTTPFileByIPD(unsigned char ipd, const char * data, const int timeout) {
+	WorkItemStruct * item = (WorkItemStruct *) _getNewWorkQueueItem(ipd, WiFiSDCoopLib_TYPE_HTTPFILE, timeout);
+	item->str = (char *) malloc(sizeof(char) * (strlen(data) + 1));
+	strcpy(item->str, data);
+}
+
+bool WiFiSDCoopLibBase::receiveFileByIPD(const unsigned char ipd, const String path) {
+	return receiveFileByIPD(ipd, path.c_str());
+}
+
+void WiFiSDCoopLibBase::publish(const unsigned char channel, const String data) {
+	publish(channel, data.c_str());
+}
+
+
+
+// File cache. No eviction: when it's full new files are just sent from SD.
+void WiFiSDCoopLibFileCache::setSize(const unsigned int size) {
+	clear();
+	_size = size;
+}
+
+const char * WiFiSDCoopLibFileCache::get(const char * path, unsigned int * length) {
+	FileCacheStruct * entry = _entries;
+	while (entry != NULL) {
+		if (strcmp(entry->path, path) == 0) {
+			if (length != NULL) {
+				*length = entry->length;
+			}
+			return entry->data;
+		}
+		entry = (FileCacheStruct *) entry->next;
+	}
+	return NULL;
+}
+
+// Returns a buffer of len + 1 chars to be filled by caller, or NULL if it doesn't fit
+char * WiFiSDCoopLibFileCache::add(const char * path, const unsigned int len) {
+	unsigned int needed = len + strlen(path) + 2;
+	if (len == 0 || len > WiFiSDCoopLib_FILE_CACHE_MAX_FILE || _used + needed > _size) {
+		return NULL;
+	}
+	FileCacheStruct * entry = (FileCacheStruct *) malloc(sizeof(FileCacheStruct));
+	entry->path = (char *) malloc(sizeof(char) * (strlen(path) + 1));
+	strcpy(entry->path, path);
+	entry->data = (char *) malloc(sizeof(char) * (len + 1));
+	entry->data[len] = '\0';
+	entry->length = len;
+	entry->next = _entries;
+	_entries = entry;
+	_used += needed;
+	return entry->data;
+}
+
+// File changed, so it will be read again from SD
+void WiFiSDCoopLibFileCache::remove(const char * path) {
+	FileCacheStruct * entry = _entries;
+	FileCacheStruct * lastEntry = NULL;
+	while (entry != NULL) {
+		if (strcmp(entry->path, path) == 0) {
+			if (lastEntry == NULL) {
+				_entries = (FileCacheStruct *) entry->next;
+			} else {
+				lastEntry->next = entry->next;
+			}
+			_used -= entry->length + strlen(entry->path) + 2;
+			free(entry->path);
+			free(entry->data);
+			free(entry);
+			return;
+		}
+		lastEntry = entry;
+		entry = (FileCacheStruct *) entry->next;
+	}
+}
+
+void WiFiSDCoopLibFileCache::clear() {
+	FileCacheStruct * entry;
+	while (_entries != NULL) {
+		entry = _entries;
+		_entries = (FileCacheStruct *) entry->next;
+		free(entry->path);
+		free(entry->data);
+		free(entry);
+	}
+	_used = 0;
+}
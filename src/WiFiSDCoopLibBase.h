@@ -0,0 +1,203 @@
+/**
+ * Library to use ESP8266 WiFi with SD card reader using collaborative multitasking.
+ *
+ * Common part of WiFiSDCoopLib: settings, routes and work queue.
+ *
+ * Nothing here depends on program defines, transport or storage, so it's compiled only once (WiFiSDCoopLibBase.cpp)
+ * and shared by all WiFiSDCoopLibT instances. See WiFiSDCoopLib.h for the templated, device dependent part.
+ *
+ * @copyright Naguissa
+ * @author Naguissa
+ * @email naguissa.com@gmail.com
+ * @version 1.0.0
+ * @created 2015-06-13
+ */
+#ifndef __WiFiSDCoopLibBase__
+	#define __WiFiSDCoopLibBase__
+	#include "Arduino.h"
+	#include "WiFiSDCoopLibTasks.h"
+
+	#define WiFiSDCoopLib_TYPE_DATA 0
+	#define WiFiSDCoopLib_TYPE_FILE 1
+	#define WiFiSDCoopLib_TYPE_COMMAND 2
+	#define WiFiSDCoopLib_TYPE_CLOSEIPD 3
+	#define WiFiSDCoopLib_TYPE_HTTPFILE 4
+
+	#define WiFiSDCoopLib_RESPONSE_NO 1
+	#define WiFiSDCoopLib_RESPONSE_GENERIC 2
+	#define WiFiSDCoopLib_RESPONSE_CIPSEND 3
+	#define WiFiSDCoopLib_RESPONSE_DATA 4
+	#define WiFiSDCoopLib_RESPONSE_RESET 5
+
+	// delay after a CIPCLOSE until new transmission, in ms;. Neded to avoid "Busy" problems
+	#define WiFiSDCoopLib_TYPE_CLOSEIPD_DELAY 500
+
+	// Link (IPD) states, as notified by module with "n,CONNECT" and "n,CLOSED"
+	#define WiFiSDCoopLib_LINK_CLOSED 0
+	#define WiFiSDCoopLib_LINK_OPEN 1
+
+	// STA connection state
+	#define WiFiSDCoopLib_JOIN_NONE 0 // Not in STA mode
+	#define WiFiSDCoopLib_JOIN_JOINING 1
+	#define WiFiSDCoopLib_JOIN_JOINED 2
+	#define WiFiSDCoopLib_JOIN_FAILED 3 // Not joined on time; module auto connect may still join later
+
+	// Data sent without waiting module answer, so other modules can be served meanwhile
+	#define WiFiSDCoopLib_SEND_IDLE 0
+	#define WiFiSDCoopLib_SEND_WAIT 1 // Data written to module, waiting for its SEND OK
+	#define WiFiSDCoopLib_SEND_DONE 2 // Answered or timed out
+
+	// Range header of a request
+	#define WiFiSDCoopLib_RANGE_NONE 0
+	#define WiFiSDCoopLib_RANGE_SINGLE 1 // bytes=a-b or bytes=a-
+	#define WiFiSDCoopLib_RANGE_SUFFIX 2 // bytes=-n
+	#define WiFiSDCoopLib_RANGE_MULTI 3 // Multi-range or not satisfiable, answered with 416
+
+	// Request body sink calls: data chunk, last chunk (may be empty) or link closed before body end
+	#define WiFiSDCoopLib_BODY_MORE 0
+	#define WiFiSDCoopLib_BODY_END 1
+	#define WiFiSDCoopLib_BODY_ABORTED 2
+
+	// Server-Sent Events channels, used as a bitmask
+	#define WiFiSDCoopLib_EVENT_CHANNELS 8
+
+	// Biggest file to keep on file cache, in bytes. It's sent on a single CIPSEND, so it can't be over 2048
+	#define WiFiSDCoopLib_FILE_CACHE_MAX_FILE 1024
+
+
+	// Receives request body in pieces, never longer than each +IPD payload: void SINK(const unsigned char IPD, const char * DATA, const unsigned int LENGTH, const char STATE);
+	typedef void (*WiFiSDCoopLibBodySink)(const unsigned char, const char *, const unsigned int, const char);
+
+
+	// Small files kept in RAM, so they're read only once from SD. Can be shared by several instances.
+	class WiFiSDCoopLibFileCache {
+		public:
+			void setSize(const unsigned int);
+			// Length is set, if given, as data may contain NULs
+			const char * get(const char *, unsigned int * = NULL);
+			char * add(const char *, const unsigned int);
+			void remove(const char *);
+			void clear();
+
+		private:
+			typedef struct {
+				char * path = NULL;
+				char * data = NULL;
+				unsigned int length = 0;
+				void * next = NULL;
+			} FileCacheStruct;
+			FileCacheStruct * _entries = NULL;
+			unsigned int _size = 0;
+			unsigned int _used = 0;
+	};
+
+
+	class WiFiSDCoopLibBase {
+		friend class WiFiSDCoopLibMulti;
+
+		public:
+			WiFiSDCoopLibBase();
+
+			virtual void reinit() = 0;
+			virtual void fastReinit() = 0;
+			// Budget in us, 0 for no limit. See WiFiSDCoopLibBase.cpp
+			void wifiLoop(const unsigned long int = 0);
+			virtual unsigned char getMaxIPDs() = 0;
+			virtual bool hasIncomingData() = 0;
+
+			void setMode(const char);
+			void setSSID(const String);
+			void setSSID(const char []);
+			void setPass(const String);
+			void setPass(const char []);
+			// Module holds received data until it's requested, so it doesn't arrive faster than it's processed. Applied on reinit
+			void setPassiveReceive(const bool);
+
+			void attachRoute(const String, void (*)(const String, const unsigned char), const char = 0);
+			void attachRoute(const char[], void (*)(const String, const unsigned char), const char = 0);
+			void clearRoutes();
+			// Use other instance route table instead own one
+			void shareRoutes(WiFiSDCoopLibBase &);
+			void setFileCache(WiFiSDCoopLibFileCache *);
+			// Sketch tasks, run on wifiLoop() and while waiting for module. Can be shared by several instances
+			void setTasks(WiFiSDCoopLibTasks *);
+
+			void sendDataByIPD(const unsigned char, const String, const int = 2000);
+			void sendDataByIPD(const unsigned char, const char *, const int = 2000);
+			void sendDataByIPD(const unsigned char, const char, const int = 500);
+			void sendDataByIPD(const unsigned char, const int, const int = 500);
+
+			void sendFileByIPD(const unsigned char, const String, const int = 2000);
+			void sendFileByIPD(const unsigned char, const char *, const int = 2000);
+			// Whole HTTP response: status, headers and file, honouring request Range header
+			void sendHTTPFileByIPD(const unsigned char, const String, const int = 2000);
+			void sendHTTPFileByIPD(const unsigned char, const char *, const int = 2000);
+
+			// Request body destination; only from route handler. Link is closed when body ends
+			virtual void setBodySink(const unsigned char, WiFiSDCoopLibBodySink) = 0;
+			// Request body to SD file, answering 201 when finished. False if another upload is active or file can't be created
+			virtual bool receiveFileByIPD(const unsigned char, const char *) = 0;
+			bool receiveFileByIPD(const unsigned char, const String);
+
+			// Server-Sent Events: from route handler keeps link open as text/event-stream, receiving channels in bitmask
+			virtual bool subscribeEventsByIPD(const unsigned char, const unsigned char = 1) = 0;
+			// Sends to all subscribers as "event: CHANNEL" with that data (single line). Updates not delivered yet are replaced
+			virtual void publish(const unsigned char, const char *) = 0;
+			void publish(const unsigned char, const String);
+
+			// Internal use, but public because may be useful externally
+			void itocp(char *, int);
+
+		protected:
+			char *ssid = NULL;
+			char *pass = NULL;
+			char mode = '2'; //1= Sta, 2= AP, 3=both. Sta is a device, AP is a router
+			bool _passiveReceive = false;
+			typedef struct {
+				char * route = NULL;
+				void (* fp)(const String, const unsigned char);
+				char mode; // 0 same string, 1 starts with, 2 ends with, 3 found in any position
+				void * next = NULL;
+			} IPDStruct;
+			IPDStruct * IPDs = NULL;
+			IPDStruct ** _routeTable = &IPDs; // Own IPDs or other instance one, if shared
+			unsigned char _ipdOffset = 0; // Added to IPD when calling routes; used by WiFiSDCoopLibMulti to number all links
+			WiFiSDCoopLibFileCache * _fileCache = NULL;
+			WiFiSDCoopLibTasks * _tasks = NULL;
+			unsigned long int _loopStart = 0; // micros() when actual wifiLoop() started
+			unsigned long int _loopBudget = 0;
+			inline void _runTasks() {
+				if (_tasks != NULL) {
+					_tasks->runDue();
+				}
+			}
+			inline bool _overBudget() {
+				return _loopBudget > 0 && micros() - _loopStart >= _loopBudget;
+			}
+			virtual void _wifiLoopSteps() = 0;
+			void _clearRoutes(IPDStruct *);
+			void * _attachRoute_common();
+			IPDStruct * _findRoute(const String);
+			typedef struct {
+				char * str = NULL;
+				char mode; // 0 string, 1 file, 2 command, 3 close, 4 file with HTTP headers
+				unsigned char ipd;
+				int timeout;
+				bool purge = false; // Link closed, remove without processing
+				void * next = NULL;
+			} WorkItemStruct;
+			WorkItemStruct * WorkQueue = NULL;
+
+			void _cleanWorkQueue();
+			void _cleanWorkQueueSub(WorkItemStruct * item);
+			void * _getNewWorkQueueItem(const unsigned char, char, const int);
+			void _removeWorkQueueItem(WorkItemStruct *);
+			bool _hasWork(const unsigned char);
+
+			void _sendCommandByIPD(const unsigned char, const char*, const int = 500);
+			void _sendCommandByIPD(const unsigned char, const String, const int = 500);
+			void _sendCloseIPD(const unsigned char);
+
+			unsigned long int _waitAfterIPDTimer = 0;
+	};
+#endif
@@ -0,0 +1,243 @@
+/**
+ * Library to use ESP8266 WiFi with SD card reader using collaborative multitasking.
+ *
+ * Front end to use several modules as a single server. See WiFiSDCoopLibMulti.h
+ *
+ * @copyright Naguissa
+ * @author Naguissa
+ * @email naguissa.com@gmail.com
+ * @version 1.0.0
+ * @created 2015-06-13
+ */
+#include <Arduino.h>
+#include "WiFiSDCoopLibMulti.h"
+
+
+
+bool WiFiSDCoopLibMulti::addModule(WiFiSDCoopLibBase & module) {
+	if (_modulesCount >= WiFiSDCoopLib_MULTI_MAX_MODULES || _nextIPD + module.getMaxIPDs() > 255) {
+		return false;
+	}
+	module._ipdOffset = _nextIPD;
+	_nextIPD += module.getMaxIPDs();
+	if (_modulesCount > 0) {
+		module.shareRoutes(*_modules[0]);
+	}
+	module.setFileCache(_fileCacheEnabled ? &_fileCache : NULL);
+	module.setTasks(_tasks);
+	_modules[_modulesCount] = &module;
+	_modulesCount++;
+	return true;
+}
+
+// Module serving that global IPD, or NULL
+WiFiSDCoopLibBase * WiFiSDCoopLibMulti::getModule(const unsigned char ipd) {
+	unsigned char localIPD;
+	return _getModule(ipd, &localIPD);
+}
+
+WiFiSDCoopLibBase * WiFiSDCoopLibMulti::_getModule(const unsigned char ipd, unsigned char * localIPD) {
+	for (unsigned char i = 0; i < _modulesCount; i++) {
+		if (ipd < _modules[i]->_ipdOffset + _modules[i]->getMaxIPDs()) {
+			*localIPD = ipd - _modules[i]->_ipdOffset;
+			return _modules[i];
+		}
+	}
+	return NULL;
+}
+
+
+void WiFiSDCoopLibMulti::reinit() {
+	for (unsigned char i = 0; i < _modulesCount; i++) {
+		_modules[i]->reinit();
+	}
+}
+
+void WiFiSDCoopLibMulti::fastReinit() {
+	for (unsigned char i = 0; i < _modulesCount; i++) {
+		_modules[i]->fastReinit();
+	}
+}
+
+// Modules with incoming data go first, as their serial buffer may overflow while others are served; then the rest.
+// Start point rotates each call, so no module waits always for all the others. Modules reached with budget used wait next call.
+void WiFiSDCoopLibMulti::wifiLoop(const unsigned long int budget) {
+	bool served[WiFiSDCoopLib_MULTI_MAX_MODULES];
+	bool ran;
+	unsigned char i, m;
+	unsigned long int start = micros();
+	if (_modulesCount == 0) {
+		return;
+	}
+	for (i = 0; i < _modulesCount; i++) {
+		m = (_nextModule + i) % _modulesCount;
+		served[m] = _modules[m]->hasIncomingData();
+		if (served[m]) {
+			_loopModule(m, start, budget);
+		}
+	}
+	for (i = 0; i < _modulesCount; i++) {
+		m = (_nextModule + i) % _modulesCount;
+		if (!served[m]) {
+			_loopModule(m, start, budget);
+		}
+	}
+	_nextModule = (_nextModule + 1) % _modulesCount;
+	if (budget > 0 && _tasks != NULL) { // Remaining time, as on WiFiSDCoopLibBase::wifiLoop()
+		do {
+			ran = _tasks->runDue();
+			ran = _tasks->runIdle() || ran;
+		} while (ran && micros() - start < budget);
+	}
+}
+
+// Module steps only; idle tasks run once, after all modules
+void WiFiSDCoopLibMulti::_loopModule(const unsigned char m, const unsigned long int start, const unsigned long int budget) {
+	if (budget > 0 && micros() - start >= budget) {
+		return;
+	}
+	_modules[m]->_loopStart = start;
+	_modules[m]->_loopBudget = budget;
+	_modules[m]->_runTasks();
+	_modules[m]->_wifiLoopSteps();
+	_modules[m]->_loopBudget = 0;
+}
+
+void WiFiSDCoopLibMulti::setTasks(WiFiSDCoopLibTasks * tasks) {
+	_tasks = tasks;
+	for (unsigned char i = 0; i < _modulesCount; i++) {
+		_modules[i]->setTasks(tasks);
+	}
+}
+
+
+void WiFiSDCoopLibMulti::attachRoute(const String route, void (*fp)(const String, const unsigned char), const char mode) {
+	if (_modulesCount > 0) {
+		_modules[0]->attachRoute(route, fp, mode);
+	}
+}
+
+void WiFiSDCoopLibMulti::attachRoute(const char route[], void (*fp)(const String, const unsigned char), const char mode) {
+	if (_modulesCount > 0) {
+		_modules[0]->attachRoute(route, fp, mode);
+	}
+}
+
+void WiFiSDCoopLibMulti::clearRoutes() {
+	if (_modulesCount > 0) {
+		_modules[0]->clearRoutes();
+	}
+}
+
+
+void WiFiSDCoopLibMulti::setFileCacheSize(const unsigned int size) {
+	_fileCache.setSize(size);
+	_fileCacheEnabled = size > 0;
+	for (unsigned char i = 0; i < _modulesCount; i++) {
+		_modules[i]->setFileCache(_fileCacheEnabled ? &_fileCache : NULL);
+	}
+}
+
+void WiFiSDCoopLibMulti::clearFileCache() {
+	_fileCache.clear();
+}
+
+
+// Send functions, work is queued on module serving that IPD
+void WiFiSDCoopLibMulti::sendDataByIPD(const unsigned char ipd, const String data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendDataByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::sendDataByIPD(const unsigned char ipd, const char * data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendDataByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::sendDataByIPD(const unsigned char ipd, const char data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendDataByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::sendDataByIPD(const unsigned char ipd, const int data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendDataByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::sendFileByIPD(const unsigned char ipd, const String data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendFileByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::sendFileByIPD(const unsigned char ipd, const char * data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendFileByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::sendHTTPFileByIPD(const unsigned char ipd, const String data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendHTTPFileByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::sendHTTPFileByIPD(const unsigned char ipd, const char * data, const int timeout) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->sendHTTPFileByIPD(localIPD, data, timeout);
+	}
+}
+
+void WiFiSDCoopLibMulti::setBodySink(const unsigned char ipd, WiFiSDCoopLibBodySink sink) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	if (module != NULL) {
+		module->setBodySink(localIPD, sink);
+	}
+}
+
+bool WiFiSDCoopLibMulti::receiveFileByIPD(const unsigned char ipd, const String path) {
+	return receiveFileByIPD(ipd, path.c_str());
+}
+
+bool WiFiSDCoopLibMulti::receiveFileByIPD(const unsigned char ipd, const char * path) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	return module != NULL && module->receiveFileByIPD(localIPD, path);
+}
+
+bool WiFiSDCoopLibMulti::subscribeEventsByIPD(const unsigned char ipd, const unsigned char channels) {
+	unsigned char localIPD;
+	WiFiSDCoopLibBase * module = _getModule(ipd, &localIPD);
+	return module != NULL && module->subscribeEventsByIPD(localIPD, channels);
+}
+
+void WiFiSDCoopLibMulti::publish(const unsigned char channel, const String data) {
+	publish(channel, data.c_str());
+}
+
+void WiFiSDCoopLibMulti::publish(const unsigned char channel, const char * data) {
+	for (unsigned char i = 0; i < _modulesCount; i++) {
+		_modules[i]->publish(channel, data);
+	}
+}
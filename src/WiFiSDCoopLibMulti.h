@@ -0,0 +1,88 @@
+/**
+ * Library to use ESP8266 WiFi with SD card reader using collaborative multitasking.
+ *
+ * Front end to use several modules, each one on its own serial, as a single server:
+ *
+ *     WiFiSDCoopLibT<HardwareSerial, SDClass, 128, 8> ESP1(Serial2, SD), ESP2(Serial3, SD);
+ *     WiFiSDCoopLibMulti ESP;
+ *     ESP.addModule(ESP1);
+ *     ESP.addModule(ESP2);
+ *
+ * Each module keeps its own settings (mode, SSID...), parser, link table and work queue; so one can be an AP and other a STA.
+ * Routes and file cache are shared. Add modules before attaching routes.
+ *
+ * Links of all modules are numbered consecutively: first module uses IPDs 0 to its max - 1, second one the following ones...
+ * Routes receive that global IPD, so always answer using this front end send functions, not the module ones.
+ *
+ * Modules are served round-robin, the ones with incoming data first. Data is written after CIPSEND '>' and its SEND OK
+ * is checked on later loops, so each module keeps one send in flight while the others are served, and file throughput
+ * grows with the number of modules. Headers and events are still sent waiting for SEND OK.
+ * A link belongs to the module its client connected to, so clients can't be moved between modules: load is balanced
+ * only by how clients spread themselves (e.g. each module on a different AP or network).
+ *
+ * @copyright Naguissa
+ * @author Naguissa
+ * @email naguissa.com@gmail.com
+ * @version 1.0.0
+ * @created 2015-06-13
+ */
+#ifndef __WiFiSDCoopLibMulti__
+	#define __WiFiSDCoopLibMulti__
+	#include "Arduino.h"
+	#include "WiFiSDCoopLibBase.h"
+
+	#define WiFiSDCoopLib_MULTI_MAX_MODULES 4
+
+
+	class WiFiSDCoopLibMulti {
+		public:
+			bool addModule(WiFiSDCoopLibBase &);
+			WiFiSDCoopLibBase * getModule(const unsigned char);
+
+			void reinit();
+			void fastReinit();
+			// Budget in us for all modules, 0 for no limit
+			void wifiLoop(const unsigned long int = 0);
+			void setTasks(WiFiSDCoopLibTasks *);
+
+			void attachRoute(const String, void (*)(const String, const unsigned char), const char = 0);
+			void attachRoute(const char[], void (*)(const String, const unsigned char), const char = 0);
+			void clearRoutes();
+
+			// Shared cache of small SD files, in bytes. 0 disables it (default)
+			void setFileCacheSize(const unsigned int);
+			void clearFileCache();
+
+			void sendDataByIPD(const unsigned char, const String, const int = 2000);
+			void sendDataByIPD(const unsigned char, const char *, const int = 2000);
+			void sendDataByIPD(const unsigned char, const char, const int = 500);
+			void sendDataByIPD(const unsigned char, const int, const int = 500);
+
+			void sendFileByIPD(const unsigned char, const String, const int = 2000);
+			void sendFileByIPD(const unsigned char, const char *, const int = 2000);
+			void sendHTTPFileByIPD(const unsigned char, const String, const int = 2000);
+			void sendHTTPFileByIPD(const unsigned char, const char *, const int = 2000);
+
+			void setBodySink(const unsigned char, WiFiSDCoopLibBodySink);
+			bool receiveFileByIPD(const unsigned char, const String);
+			bool receiveFileByIPD(const unsigned char, const char *);
+
+			bool subscribeEventsByIPD(const unsigned char, const unsigned char = 1);
+			// To subscribers of all modules
+			void publish(const unsigned char, const String);
+			void publish(const unsigned char, const char *);
+
+		private:
+			WiFiSDCoopLibBase * _modules[WiFiSDCoopLib_MULTI_MAX_MODULES];
+			unsigned char _modulesCount = 0;
+			unsigned char _nextModule = 0; // Round-robin start point
+			unsigned int _nextIPD = 0; // First global IPD of next added module
+			WiFiSDCoopLibFileCache _fileCache;
+			bool _fileCacheEnabled = false;
+
+			WiFiSDCoopLibTasks * _tasks = NULL;
+
+			WiFiSDCoopLibBase * _getModule(const unsigned char, unsigned char *);
+			void _loopModule(const unsigned char, const unsigned long int, const unsigned long int);
+	};
+#endif
@@ -0,0 +1,144 @@
+/**
+ * Library to use ESP8266 WiFi with SD card reader using collaborative multitasking.
+ *
+ * Serial reception sources. Parser reads data from them in spans:
+ *     unsigned int available();
+ *     unsigned int readBytes(char * buffer, const unsigned int length); // Returns read chars, never waits
+ *
+ * WiFiSDCoopLibStreamRx: reads directly from the device, as any Arduino Stream. Default one.
+ * WiFiSDCoopLibRingRx<SIZE>: ring buffer filled outside the library, from UART RX interrupt or DMA events, using push()
+ *     or pushBytes(). Doesn't overflow while the program is busy on SD or handlers, as small Arduino RX buffers do.
+ *     Also useful to feed the library by hand on a computer.
+ *
+ * @copyright Naguissa
+ * @author Naguissa
+ * @email naguissa.com@gmail.com
+ * @version 1.0.0
+ * @created 2015-06-13
+ */
+#ifndef __WiFiSDCoopLibRx__
+	#define __WiFiSDCoopLibRx__
+	#include "Arduino.h"
+
+
+	template <class DevT>
+	class WiFiSDCoopLibStreamRx {
+		public:
+			WiFiSDCoopLibStreamRx(DevT & dev) : _dev(dev) {}
+
+			inline unsigned int available() {
+				return _dev.available();
+			}
+
+			inline unsigned int readBytes(char * buffer, const unsigned int length) {
+				unsigned int count = 0;
+				while (count < length && _dev.available()) {
+					buffer[count] = _dev.read();
+					count++;
+				}
+				return count;
+			}
+
+		private:
+			DevT & _dev;
+	};
+
+
+	// Ring indexes: a single byte while they fit, so they're read and written atomically on 8 bit MCUs
+	template <bool Small>
+	struct WiFiSDCoopLibRingIndex {
+		typedef uint16_t type;
+	};
+
+	template <>
+	struct WiFiSDCoopLibRingIndex<true> {
+		typedef uint8_t type;
+	};
+
+
+	// Single producer (ISR / DMA) and single consumer (library). SIZE must be power of 2
+	template <unsigned int Size>
+	class WiFiSDCoopLibRingRx {
+		static_assert((Size & (Size - 1)) == 0, "WiFiSDCoopLibRingRx size must be power of 2");
+		typedef typename WiFiSDCoopLibRingIndex<Size <= 256>::type IndexT;
+
+		public:
+			template <class DevT>
+			WiFiSDCoopLibRingRx(DevT &) {}
+
+			// Producer side, ISR safe. False if buffer is full and char is lost
+			inline bool push(const char c) {
+				IndexT next = (_head + 1) & (Size - 1);
+				if (next == _tail) {
+					_overflows++;
+					return false;
+				}
+				_buffer[_head] = c;
+				_head = next;
+				return true;
+			}
+
+			unsigned int pushBytes(const char * data, const unsigned int length) {
+				unsigned int count = 0;
+				while (count < length && push(data[count])) {
+					count++;
+				}
+				return count;
+			}
+
+			// Consumer side
+			inline unsigned int available() {
+				return (_getHead() - _tail) & (Size - 1);
+			}
+
+			unsigned int readBytes(char * buffer, const unsigned int length) {
+				IndexT head = _getHead();
+				IndexT tail = _tail;
+				unsigned int count = 0;
+				while (count < length && tail != head) {
+					buffer[count] = _buffer[tail];
+					tail = (tail + 1) & (Size - 1);
+					count++;
+				}
+				_setTail(tail);
+				return count;
+			}
+
+			unsigned int getOverflows() {
+				return _overflows;
+			}
+
+		private:
+			volatile char _buffer[Size];
+			volatile IndexT _head = 0;
+			volatile IndexT _tail = 0;
+			volatile unsigned int _overflows = 0;
+
+			// On 8 bit MCUs a 16 bit index can be modified by ISR while it's accessed. Interrupt state is restored, not just enabled
+			inline IndexT _getHead() {
+				#ifdef __AVR__
+					if (sizeof(IndexT) > 1) {
+						uint8_t sreg = SREG;
+						noInterrupts();
+						IndexT head = _head;
+						SREG = sreg;
+						return head;
+					}
+				#endif
+				return _head;
+			}
+
+			inline void _setTail(const IndexT tail) {
+				#ifdef __AVR__
+					if (sizeof(IndexT) > 1) {
+						uint8_t sreg = SREG;
+						noInterrupts();
+						_tail = tail;
+						SREG = sreg;
+						return;
+					}
+				#endif
+				_tail = tail;
+			}
+	};
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Library to use ESP8266 WiFi with SD card reader using collaborative multitasking.
+ *
+ * Sketch tasks scheduler. See WiFiSDCoopLibTasks.h
+ *
+ * @copyright Naguissa
+ * @author Naguissa
+ * @email naguissa.com@gmail.com
+ * @version 1.0.0
+ * @created 2015-06-13
+ */
+#include <Arduino.h>
+#include "WiFiSDCoopLibTasks.h"
+
+
+
+signed char WiFiSDCoopLibTasks::add(void (*fp)(), const unsigned long int period) {
+	for (signed char i = 0; i < WiFiSDCoopLib_TASKS_MAX; i++) {
+		if (_tasks[i].fp == NULL) {
+			_tasks[i].fp = fp;
+			_tasks[i].period = period;
+			_tasks[i].due = micros() + period;
+			_tasks[i].runs = 0;
+			_tasks[i].jitterMax = 0;
+			_tasks[i].jitterSum = 0;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void WiFiSDCoopLibTasks::remove(const signed char id) {
+	if (id >= 0 && id < WiFiSDCoopLib_TASKS_MAX) {
+		_tasks[(byte) id].fp = NULL;
+	}
+}
+
+
+bool WiFiSDCoopLibTasks::runDue() {
+	bool ran = false;
+	unsigned long int now, late;
+	if (_running) {
+		return false;
+	}
+	_running = true;
+	for (byte i = 0; i < WiFiSDCoopLib_TASKS_MAX; i++) {
+		if (_tasks[i].fp == NULL || _tasks[i].period == 0) {
+			continue;
+		}
+		now = micros();
+		late = now - _tasks[i].due;
+		if ((long int) late < 0) { // Not yet; difference is used because micros() overflows
+			continue;
+		}
+		_tasks[i].runs++;
+		_tasks[i].jitterSum += late;
+		if (late > _tasks[i].jitterMax) {
+			_tasks[i].jitterMax = late;
+		}
+		_tasks[i].due += _tasks[i].period;
+		if ((long int) (now - _tasks[i].due) >= 0) { // Missed runs are skipped
+			_tasks[i].due = now + _tasks[i].period;
+		}
+		_tasks[i].fp();
+		ran = true;
+	}
+	_running = false;
+	return ran;
+}
+
+bool WiFiSDCoopLibTasks::runIdle() {
+	bool found = false;
+	if (_running) {
+		return false;
+	}
+	_running = true;
+	for (byte i = 0; i < WiFiSDCoopLib_TASKS_MAX; i++) {
+		if (_tasks[i].fp != NULL && _tasks[i].period == 0) {
+			_tasks[i].runs++;
+			_tasks[i].fp();
+			found = true;
+		}
+	}
+	_running = false;
+	return found;
+}
+
+
+unsigned long int WiFiSDCoopLibTasks::getRuns(const signed char id) {
+	return id >= 0 && id < WiFiSDCoopLib_TASKS_MAX ? _tasks[(byte) id].runs : 0;
+}
+
+unsigned long int WiFiSDCoopLibTasks::getMaxJitter(const signed char id) {
+	return id >= 0 && id < WiFiSDCoopLib_TASKS_MAX ? _tasks[(byte) id].jitterMax : 0;
+}
+
+unsigned long int WiFiSDCoopLibTasks::getAvgJitter(const signed char id) {
+	if (id < 0 || id >= WiFiSDCoopLib_TASKS_MAX || _tasks[(byte) id].runs == 0) {
+		return 0;
+	}
+	return _tasks[(byte) id].jitterSum / _tasks[(byte) id].runs;
+}
+
+void WiFiSDCoopLibTasks::resetStats() {
+	for (byte i = 0; i < WiFiSDCoopLib_TASKS_MAX; i++) {
+		_tasks[i].runs = 0;
+		_tasks[i].jitterMax = 0;
+		_tasks[i].jitterSum = 0;
+	}
+}
@@ -0,0 +1,57 @@
+/**
+ * Library to use ESP8266 WiFi with SD card reader using collaborative multitasking.
+ *
+ * Sketch tasks, run by the library between its own work and while it waits for the module:
+ *
+ *     WiFiSDCoopLibTasks tasks;
+ *     tasks.add(readSensor, 10000); // Every 10 ms
+ *     tasks.add(updateDisplay); // Idle task, when there's time left
+ *     ESP.setTasks(&tasks);
+ *     ...
+ *     ESP.wifiLoop(2000); // Returns after about 2 ms, once actual step ends
+ *
+ * Periodic tasks keep their schedule: if one runs late next one isn't moved, and missed runs are skipped, not queued.
+ * Lateness of each run (jitter) is recorded. Tasks must be short and can't call wifiLoop().
+ *
+ * @copyright Naguissa
+ * @author Naguissa
+ * @email naguissa.com@gmail.com
+ * @version 1.0.0
+ * @created 2015-06-13
+ */
+#ifndef __WiFiSDCoopLibTasks__
+	#define __WiFiSDCoopLibTasks__
+	#include "Arduino.h"
+
+	#define WiFiSDCoopLib_TASKS_MAX 8
+
+
+	class WiFiSDCoopLibTasks {
+		public:
+			// Period in us; 0 for an idle task. Returns task id, or -1 if there's no room
+			signed char add(void (*)(), const unsigned long int = 0);
+			void remove(const signed char);
+
+			// Periodic tasks whose time has come. False if none
+			bool runDue();
+			// Each idle task once. False if there're none
+			bool runIdle();
+
+			unsigned long int getRuns(const signed char);
+			unsigned long int getMaxJitter(const signed char); // In us
+			unsigned long int getAvgJitter(const signed char);
+			void resetStats();
+
+		private:
+			typedef struct {
+				void (* fp)() = NULL;
+				unsigned long int period = 0;
+				unsigned long int due = 0; // micros() of next run
+				unsigned long int runs = 0;
+				unsigned long int jitterMax = 0;
+				unsigned long int jitterSum = 0;
+			} TaskStruct;
+			TaskStruct _tasks[WiFiSDCoopLib_TASKS_MAX];
+			bool _running = false; // Tasks can make library wait, and then it would run them again
+	};
+#endif